@@ -0,0 +1,218 @@
+/*
+* decrypt_signature benchmark for one bigint.c configuration
+*
+* RnD, 2021
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <fstream>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define bench_cycles()		__rdtsc()
+#else
+#define bench_cycles()		0ull
+#endif
+
+#include "ida_license.hpp"
+#include "ida_rsa_mont.hpp"
+#include "ida_rsa_builtin.hpp"
+#include "bigint.hpp"
+
+#ifndef BENCH_CONFIG
+#define BENCH_CONFIG		"default"
+#endif
+
+#define BENCH_INPUTS		64
+#define BENCH_SEED			0x13
+
+using namespace ida;
+using namespace std;
+
+// allocations made by bigint.c, the linker wraps its malloc/calloc/realloc calls
+static uint64_t g_allocs = 0;
+
+extern "C"
+{
+	void* __real_malloc(size_t size);
+	void* __real_calloc(size_t count, size_t size);
+	void* __real_realloc(void* ptr, size_t size);
+
+	void* __wrap_malloc(size_t size) { ++g_allocs; return __real_malloc(size); }
+	void* __wrap_calloc(size_t count, size_t size) { ++g_allocs; return __real_calloc(count, size); }
+	void* __wrap_realloc(void* ptr, size_t size) { ++g_allocs; return __real_realloc(ptr, size); }
+}
+
+typedef struct bench_result_t
+{
+	double ns;
+	double allocs;
+	double cycles;
+	bool valid;
+} bench_result_t;
+
+// pinned inputs and their licenses from the montgomery kernel
+static signature_t g_signs[BENCH_INPUTS];
+static license_t g_expected[BENCH_INPUTS];
+
+// xorshift64, below the modulus so the blocks look like real signatures
+static void generate_inputs(signature_t* signs)
+{
+	uint64_t state = BENCH_SEED;
+	for (size_t i = 0; i < BENCH_INPUTS; ++i)
+	{
+		signature_t& sign = signs[i];
+		for (auto& b : sign)
+		{
+			state ^= state << 13;
+			state ^= state >> 7;
+			state ^= state << 17;
+			b = static_cast<uint8_t>(state >> 32);
+		}
+		sign[0] |= 1;
+		sign[sizeof(signature_t) - 1] &= 0x7f;
+	}
+}
+
+static bool load_inputs(const string& filepath, signature_t* signs)
+{
+	ifstream file(filepath, ios::binary);
+	if (!file) return false;
+
+	file.read(reinterpret_cast<char*>(signs), BENCH_INPUTS * sizeof(signature_t));
+	return file.gcount() == static_cast<streamsize>(BENCH_INPUTS * sizeof(signature_t));
+}
+
+template<typename F>
+static bench_result_t run(size_t iterations, F decrypt)
+{
+	bench_result_t result = { 0, 0, 0, true };
+	license_t license;
+
+	// warm up caches and lazy allocations, checks every input once
+	for (size_t i = 0; i < BENCH_INPUTS; ++i)
+	{
+		decrypt(g_signs[i], license);
+		if (memcmp(&license, &g_expected[i], sizeof(license_t))) result.valid = false;
+	}
+
+	uint64_t allocs = g_allocs;
+	uint64_t cycles = bench_cycles();
+	auto start = chrono::steady_clock::now();
+
+	for (size_t i = 0; i < iterations; ++i)
+		decrypt(g_signs[i % BENCH_INPUTS], license);
+
+	auto stop = chrono::steady_clock::now();
+	cycles = bench_cycles() - cycles;
+	allocs = g_allocs - allocs;
+
+	result.ns = chrono::duration<double, nano>(stop - start).count() / iterations;
+	result.allocs = static_cast<double>(allocs) / iterations;
+	result.cycles = static_cast<double>(cycles) / iterations;
+	return result;
+}
+
+static void print(const char* mode, const bench_result_t& result)
+{
+	printf("%-36s %-9s %12.0f %10.2f %12.0f  %s\n", BENCH_CONFIG, mode,
+		result.ns, result.allocs, result.cycles, result.valid ? "ok" : "MISMATCH");
+}
+
+int main(int argc, char* argv[])
+{
+	size_t iterations = 2000;
+	string inputs = "signatures.bin";
+	bool header = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			iterations = strtoul(argv[++i], nullptr, 10);
+		else if (!strcmp(argv[i], "-i") && i + 1 < argc)
+			inputs = argv[++i];
+		else if (!strcmp(argv[i], "--header"))
+			header = true;
+		else if (!strcmp(argv[i], "--generate") && i + 1 < argc)
+		{
+			generate_inputs(g_signs);
+			ofstream file(argv[++i], ios::binary | ios::trunc);
+			file.write(reinterpret_cast<const char*>(g_signs), sizeof(g_signs));
+			return file.good() ? 0 : 1;
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [-n iterations] [-i signatures.bin] [--header] [--generate file]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (!iterations) iterations = 1;
+
+	if (!load_inputs(inputs, g_signs))
+	{
+		fprintf(stderr, "can't read %d signatures from %s\n", BENCH_INPUTS, inputs.c_str());
+		return 2;
+	}
+
+#if defined(__linux__)
+	// one core, no migrations between samples
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(0, &cpus);
+	sched_setaffinity(0, sizeof(cpus), &cpus);
+#endif
+
+	for (size_t i = 0; i < BENCH_INPUTS; ++i)
+		mont_decrypt(k_mont_official, ida_rsa_pub, g_signs[i], g_expected[i]);
+
+	if (header)
+		printf("%-36s %-9s %12s %10s %12s  %s\n", "config", "mode", "ns/op", "allocs/op", "cycles/op", "check");
+
+	// the custom modulus keeps decrypt_signature on bigint.c, with the whole setup per call
+	print("oneshot", run(iterations, [](const signature_t& sign, license_t& license)
+	{
+		decrypt_signature(sign, license, ida_rsa_mod);
+	}));
+
+	// one context with the modulus set, as rsa_modulus keeps it for bigint moduli
+	signature_t modulus;
+	memcpy(modulus, ida_rsa_mod, sizeof(signature_t));
+	reverse_block(modulus, sizeof(signature_t));
+
+	BI_CTX* BI = bi_initialize();
+	bi_set_mod(BI, bi_import(BI, modulus, IDA_RSA_BLOCK_SIZE), BIGINT_M_OFFSET);
+	bigint* pub = int_to_bi(BI, ida_rsa_pub);
+	bi_permanent(pub);
+
+	print("session", run(iterations, [BI, pub](const signature_t& sign, license_t& license)
+	{
+		signature_t data;
+		memcpy(data, sign, sizeof(signature_t));
+		reverse_block(data, sizeof(signature_t));
+
+		bigint* msg = bi_import(BI, data, IDA_RSA_BLOCK_SIZE);
+		bigint* emsg = bi_mod_power(BI, msg, pub);
+		bi_export(BI, emsg, reinterpret_cast<uint8_t*>(&license), IDA_RSA_BLOCK_SIZE);
+	}));
+
+	bi_depermanent(pub);
+	bi_free(BI, pub);
+	bi_free_mod(BI, BIGINT_M_OFFSET);
+	bi_terminate(BI);
+
+	// the fixed-width kernel for comparison, independent of the bigint.c configuration
+	print("mont", run(iterations, [](const signature_t& sign, license_t& license)
+	{
+		mont_decrypt(k_mont_official, ida_rsa_pub, sign, license);
+	}));
+	return 0;
+}
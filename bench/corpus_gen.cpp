@@ -0,0 +1,1041 @@
+/*
+* Synthetic corpus generator for every input type of ida_key_checker
+*
+* RnD, 2021
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+
+#include "ida_key.hpp"
+#include "ida_license.hpp"
+#include "ida_rays_license.hpp"
+#include "ida_rsa_mont.hpp"
+#include "ida_rsa_builtin.hpp"
+#include "ida_rsa_registry.hpp"
+#include "ida_date.hpp"
+
+#define CORPUS_SEED			0x13
+#define CORPUS_SHARD		1000		// files per directory
+#define CORPUS_MR_ROUNDS	32			// miller-rabin rounds per prime
+#define CORPUS_POSIX_GAP	256			// license before the version text in posix modules
+
+using namespace ida;
+using namespace std;
+using namespace filesystem;
+
+enum ECorpusType
+{
+	ECorpusType_Key = 0,
+	ECorpusType_Bin,
+	ECorpusType_PE,
+	ECorpusType_ELF,
+	ECorpusType_MachO,
+	ECorpusType_IDB,
+	ECorpusType_Count
+};
+
+typedef struct corpus_type_t
+{
+	const char* name;	// -t name and directory
+	const char* ext;
+} corpus_type_t;
+
+static const corpus_type_t k_types[ECorpusType_Count] = {
+	{ "key", ".key" },
+	{ "bin", ".bin" },
+	{ "pe", ".dll" },
+	{ "elf", ".so" },
+	{ "macho", ".dylib" },
+	{ "idb", ".idb" },
+};
+
+typedef struct corpus_options_t
+{
+	path output;
+	uint64_t seed = CORPUS_SEED;
+	size_t count = 100;			// files per type
+	uint32_t types = (1u << ECorpusType_Count) - 1;
+	unsigned threads = 0;		// 0 = one per core
+	size_t text_size = 0x10000;	// code section of the module shells
+	size_t data_size = 0x10000;	// data section holding the license block
+	size_t offset = SIZE_MAX;	// block offset in the data section, random if not set
+} corpus_options_t;
+
+// splitmix64, the stream of a file depends on the seed, its type and index only,
+// so any file can be made again alone and the thread count does not matter
+class corpus_rng
+{
+public:
+	corpus_rng(uint64_t seed) : m_state(seed) {}
+	corpus_rng(uint64_t seed, uint64_t type, uint64_t index) : m_state(seed)
+	{
+		m_state = next() ^ type;
+		m_state = next() ^ index;
+	}
+
+	uint64_t next()
+	{
+		uint64_t z = (m_state += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+	// modulo bias is irrelevant here, the result only has to be reproducible
+	uint32_t below(uint32_t n) { return static_cast<uint32_t>(next() % n); }
+
+	void fill(void* data, size_t size)
+	{
+		uint8_t* bytes = static_cast<uint8_t*>(data);
+		for (size_t i = 0; i < size; i += 8)
+		{
+			uint64_t v = next();
+			memcpy(bytes + i, &v, min<size_t>(8, size - i));
+		}
+	}
+
+private:
+	uint64_t m_state;
+};
+
+// little-endian fields of the file formats
+static void put16(uint8_t* p, size_t offset, uint16_t v) { for (size_t i = 0; i < 2; ++i) p[offset + i] = static_cast<uint8_t>(v >> (i * 8)); }
+static void put32(uint8_t* p, size_t offset, uint32_t v) { for (size_t i = 0; i < 4; ++i) p[offset + i] = static_cast<uint8_t>(v >> (i * 8)); }
+static void put64(uint8_t* p, size_t offset, uint64_t v) { for (size_t i = 0; i < 8; ++i) p[offset + i] = static_cast<uint8_t>(v >> (i * 8)); }
+
+static size_t align_up(size_t value, size_t align)
+{
+	return (value + align - 1) / align * align;
+}
+
+// Test rsa key
+
+typedef struct test_key_t
+{
+	signature_t modulus;	// ida byte order
+	mont_modulus_t mont;
+	mont_limbs_t d;			// private exponent
+} test_key_t;
+
+const size_t N = IDA_MONT_LIMBS;
+
+// a mod m, m below 2^32
+static uint32_t limbs_mod(const uint64_t* a, size_t count, uint32_t m)
+{
+	uint64_t r = 0;
+	for (size_t i = count; i--; )
+	{
+		r = ((r << 32) | (a[i] >> 32)) % m;
+		r = ((r << 32) | (a[i] & 0xffffffff)) % m;
+	}
+	return static_cast<uint32_t>(r);
+}
+
+// a /= m, m below 2^32
+static void limbs_div(uint64_t* a, size_t count, uint32_t m)
+{
+	uint64_t r = 0;
+	for (size_t i = count; i--; )
+	{
+		uint64_t hi = (r << 32) | (a[i] >> 32);
+		r = hi % m;
+		uint64_t lo = (r << 32) | (a[i] & 0xffffffff);
+		r = lo % m;
+		a[i] = ((hi / m) << 32) | (lo / m);
+	}
+}
+
+// r = a * b, r has 2 * count limbs
+static void limbs_mul(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t count)
+{
+	memset(r, 0, 2 * count * sizeof(uint64_t));
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint64_t carry = 0;
+		for (size_t j = 0; j < count; ++j)
+			r[i + j] = mont_mac_c(a[j], b[i], r[i + j], carry);
+		r[i + count] = carry;
+	}
+}
+
+// a = a * k + c
+static void limbs_mul_add(uint64_t* a, size_t count, uint64_t k, uint64_t c)
+{
+	uint64_t carry = c;
+	for (size_t i = 0; i < count; ++i)
+		a[i] = mont_mac_c(a[i], k, 0, carry);
+}
+
+static void limbs_to_block(const mont_limbs_t& a, uint8_t* block)
+{
+	for (size_t i = 0; i < N; ++i)
+		put64(block, i * 8, a[i]);
+}
+
+// r = x^e mod n for a plain x < n, e of the given bits, 4-bit fixed window
+static void mod_pow(mont_limbs_t& r, const mont_limbs_t& x, const uint64_t* e, size_t bits,
+	const mont_modulus_t& mod)
+{
+	mont_limbs_t table[16], one = { 1 };
+	mont_mul(table[0], one, mod.rr, mod);
+	mont_mul(table[1], x, mod.rr, mod);
+	for (size_t i = 2; i < 16; ++i)
+		mont_mul(table[i], table[i - 1], table[1], mod);
+
+	memcpy(r, table[0], sizeof(mont_limbs_t));
+	for (size_t w = (bits + 3) / 4; w--; )
+	{
+		for (size_t i = 0; i < 4; ++i)
+			mont_sqr(r, r, mod);
+		unsigned digit = static_cast<unsigned>(e[w * 4 / 64] >> (w * 4 % 64)) & 15;
+		if (digit) mont_mul(r, r, table[digit], mod);
+	}
+	mont_mul(r, r, one, mod);
+}
+
+static const vector<uint32_t>& small_primes()
+{
+	static const vector<uint32_t> primes = []()
+	{
+		vector<uint32_t> result;
+		vector<bool> composite(2048);
+		for (uint32_t i = 3; i < composite.size(); i += 2)
+		{
+			if (composite[i]) continue;
+			result.push_back(i);
+			for (uint32_t j = i * i; j < composite.size(); j += 2 * i)
+				composite[j] = true;
+		}
+		return result;
+	}();
+	return primes;
+}
+
+// p odd, below 2^512
+static bool is_probable_prime(const mont_limbs_t& p, corpus_rng& rng)
+{
+	for (uint32_t q : small_primes())
+		if (!limbs_mod(p, N, q)) return false;
+
+	signature_t block;
+	mont_modulus_t mod;
+	limbs_to_block(p, block);
+	if (!mont_init(mod, block)) return false;
+
+	// p - 1 = d * 2^s
+	mont_limbs_t p1, d, one = { 1 };
+	memcpy(p1, p, sizeof(mont_limbs_t));
+	p1[0] ^= 1;
+	memcpy(d, p1, sizeof(mont_limbs_t));
+	size_t s = 0;
+	while (!(d[0] & 1))
+	{
+		for (size_t i = 0; i < N; ++i)
+			d[i] = (d[i] >> 1) | (i + 1 < N ? d[i + 1] << 63 : 0);
+		++s;
+	}
+
+	for (size_t round = 0; round < CORPUS_MR_ROUNDS; ++round)
+	{
+		// a witness below p, 2 or more
+		mont_limbs_t a = { 0 }, x;
+		for (size_t i = 0; i < N / 2 - 1; ++i)
+			a[i] = rng.next();
+		a[0] |= 2;
+
+		mod_pow(x, a, d, N / 2 * 64, mod);
+		if (!memcmp(x, one, sizeof(x)) || !memcmp(x, p1, sizeof(x))) continue;
+
+		bool composite = true;
+		for (size_t i = 1; i < s && composite; ++i)
+		{
+			mont_mul(x, x, x, mod);
+			mont_mul(x, x, mod.rr, mod);
+			if (!memcmp(x, p1, sizeof(x))) composite = false;
+		}
+		if (composite) return false;
+	}
+	return true;
+}
+
+// 512-bit prime with the top two bits set, so p * q has 1024 bits, and e coprime to p - 1
+static void random_prime(mont_limbs_t& p, corpus_rng& rng)
+{
+	for (;;)
+	{
+		memset(p, 0, sizeof(mont_limbs_t));
+		for (size_t i = 0; i < N / 2; ++i)
+			p[i] = rng.next();
+		p[N / 2 - 1] |= 0xc000000000000000ull;
+		p[0] |= 1;
+
+		if (limbs_mod(p, N, ida_rsa_pub) == 1) continue;
+		if (is_probable_prime(p, rng)) return;
+	}
+}
+
+// the same seed always gives the same key
+static bool make_test_key(uint64_t seed, test_key_t& key)
+{
+	corpus_rng rng(seed, ECorpusType_Count, 0);
+	mont_limbs_t p, q;
+	random_prime(p, rng);
+	do random_prime(q, rng); while (!memcmp(p, q, sizeof(p)));
+
+	uint64_t n[N];
+	limbs_mul(n, p, q, N / 2);
+	limbs_to_block(n, key.modulus);
+	if (!mont_init(key.mont, key.modulus)) return false;
+
+	// d = (1 + k * phi) / e for the k making it exact
+	uint64_t phi[N + 1] = { 0 };
+	p[0] ^= 1;
+	q[0] ^= 1;
+	limbs_mul(phi, p, q, N / 2);
+
+	uint32_t r = limbs_mod(phi, N, ida_rsa_pub), k = 1;
+	while ((1 + k * r) % ida_rsa_pub) ++k;
+	limbs_mul_add(phi, N + 1, k, 1);
+	limbs_div(phi, N + 1, ida_rsa_pub);
+	if (phi[N]) return false;
+
+	memcpy(key.d, phi, sizeof(mont_limbs_t));
+	return true;
+}
+
+// failed self checks, the corpus is useless if any
+static atomic<size_t> g_bad_signatures(0);
+
+// the block the checker decrypts to license, the checker skips blocks
+// with a zero low byte, another key number moves it
+static void sign_license(const test_key_t& key, license_t& license, corpus_rng& rng, signature_t& sign)
+{
+	for (;;)
+	{
+		signature_t m;
+		memcpy(m, &license, sizeof(signature_t));
+		reverse_block(m, sizeof(signature_t));
+
+		mont_limbs_t x, s;
+		mont_import(x, m);
+		mod_pow(s, x, key.d, N * 64, key.mont);
+		mont_export(s, sign);
+		reverse_block(sign, sizeof(signature_t));
+
+		if (sign[0]) break;
+		license.keyNumber = static_cast<int16_t>(rng.next());
+	}
+
+	license_t check;
+	if (!mont_decrypt(key.mont, ida_rsa_pub, sign, check) || memcmp(&check, &license, sizeof(license_t)))
+		++g_bad_signatures;
+}
+
+// Identities
+
+static const char* const k_first[] = {
+	"Alice", "Bob", "Carol", "Dave", "Erin", "Frank", "Grace", "Heidi", "Ivan", "Judy",
+	"Mallory", "Niaj", "Olivia", "Peggy", "Rupert", "Sybil", "Trent", "Victor", "Walter", "Yara",
+};
+static const char* const k_last[] = {
+	"Anders", "Brown", "Chen", "Dubois", "Evans", "Fischer", "Garcia", "Hansen", "Ivanov", "Jones",
+	"Kowalski", "Larsen", "Moreau", "Novak", "Olsen", "Petrov", "Rossi", "Schmidt", "Tanaka", "Weber",
+};
+static const char* const k_companies[] = {
+	"Example Ltd", "Test Labs", "Acme Security", "Contoso", "Initech", "Globex", "Hooli", "Vandelay",
+};
+static const char* const k_domains[] = {
+	"example.com", "example.org", "example.net",
+};
+static const char* const k_rays_versions[] = {
+	"6.8.0.150415", "7.0.0.170914", "7.2.0.181105", "7.5.0.201028", "7.6.0.210427",
+};
+static const uint16_t k_key_versions[] = { 680, 690, 700, 710, 720, 730, 740, 750, 760 };
+
+// decompiler license id prefixes, as print_rays_license names them
+typedef struct corpus_product_t
+{
+	uint8_t id;
+	uint8_t prefix;
+} corpus_product_t;
+
+static const corpus_product_t k_editions[] = {
+	{ EProduct_IDASTA, 0x48 }, { EProduct_IDAADV, 0x48 }, { EProduct_IDAPRO, 0x48 },
+	{ EProduct_IDAPC, 0x48 }, { EProduct_IDAARM, 0x48 },
+};
+static const corpus_product_t k_decompilers[] = {
+	{ EProduct_HEX86, 0x57 }, { EProduct_HEX64, 0x55 }, { EProduct_ARM, 0x56 }, { EProduct_ARM64, 0x54 },
+	{ EProduct_PPC, 0x53 }, { EProduct_PPC64, 0x52 }, { EProduct_MIPS, 0x50 },
+};
+
+typedef struct identity_t
+{
+	string first;
+	string last;
+	string company;
+	string email;
+	time_t issued;
+	time_t support; // a year later, at midnight
+} identity_t;
+
+template<typename T, size_t Size>
+static const T& pick(const T (&set)[Size], corpus_rng& rng)
+{
+	return set[rng.below(Size)];
+}
+
+static identity_t make_identity(corpus_rng& rng)
+{
+	identity_t id;
+	id.first = pick(k_first, rng);
+	id.last = pick(k_last, rng);
+	id.company = pick(k_companies, rng);
+
+	id.email = id.first + "." + id.last + "@" + pick(k_domains, rng);
+	transform(id.email.begin(), id.email.end(), id.email.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+
+	// 2012-01-01 and ten years on
+	int64_t day = days_from_civil(2012, 1, 1) + rng.below(3650);
+	id.issued = static_cast<time_t>(day * 86400 + rng.below(86400));
+	id.support = static_cast<time_t>((day + 365) * 86400);
+	return id;
+}
+
+static void make_license_id(ida::id_t& id, uint8_t prefix, corpus_rng& rng)
+{
+	rng.fill(id, sizeof(ida::id_t));
+	id[0] = prefix;
+}
+
+static void make_license(const identity_t& identity, const ida::id_t& license_id, uint16_t type,
+	uint16_t users, uint16_t version, corpus_rng& rng, license_t& license)
+{
+	memset(&license, 0, sizeof(license_t));
+	license.keyNumber = static_cast<int16_t>(rng.next());
+	license.keyVer = version;
+	license.typeLic = type;
+	license.userNumber = users;
+	license.reserved0 = -1;
+	license.reserved1 = -1;
+	license.started = static_cast<uint32_t>(identity.issued);
+	license.expSupp = static_cast<uint32_t>(identity.support);
+	memcpy(license.licenseId, license_id, sizeof(ida::id_t));
+
+	string name = identity.first + " " + identity.last + ", " + identity.company;
+	memcpy(license.username, name.data(), min(name.size(), sizeof(license.username) - 1));
+	rng.fill(license.md5, sizeof(md5_t));
+}
+
+// Files
+
+// print_key_view layout, the md5 is taken from the printed text as the checker takes it
+static vector<uint8_t> make_key(const test_key_t& test_key, corpus_rng& rng)
+{
+	identity_t identity = make_identity(rng);
+
+	ida::key_t key;
+	key.version = pick(k_key_versions, rng);
+	key.username = identity.first + " " + identity.last + ", " + identity.company;
+	key.email = identity.email;
+	key.issued = identity.issued;
+	rng.fill(key.rnd, sizeof(rnd_t));
+
+	uint8_t license_type = static_cast<uint8_t>(ELicense_Named + rng.below(3));
+	uint8_t platform = static_cast<uint8_t>(EPlatform_Windows + rng.below(3));
+
+	// an edition, then some decompilers
+	size_t products = 1 + rng.below(6);
+	for (size_t i = 0; i < products; ++i)
+	{
+		const corpus_product_t& code = i ? pick(k_decompilers, rng) : pick(k_editions, rng);
+
+		product_t product;
+		make_license_id(product.licenseId, code.prefix, rng);
+		product.product.id = code.id;
+		product.product.license = license_type;
+		product.product.platform = platform;
+		product.count = license_type == ELicense_Floating ? 1 + rng.below(10) : 1;
+		product.support = identity.support;
+		key.products.push_back(product);
+	}
+
+	string text = print_key_view(key, false);
+	ida::key_t parsed;
+	parse_key(reinterpret_cast<const uint8_t*>(text.data()), text.size(), parsed);
+
+	license_t license;
+	make_license(identity, key.products[0].licenseId, license_type,
+		static_cast<uint16_t>(key.products[0].count), key.version, rng, license);
+	memcpy(license.md5, parsed.md5, sizeof(md5_t));
+	sign_license(test_key, license, rng, key.signature);
+
+	text = print_key_view(key, true);
+	return vector<uint8_t>(text.begin(), text.end());
+}
+
+// check_file_type looks at the magics before the size, one in 65536 blocks starts with MZ
+static bool has_file_magic(const uint8_t* data)
+{
+	return !memcmp(data, "HEXRAYS_LICENSE", 15) || !memcmp(data, "MZ", 2) ||
+		(!memcmp(data, "IDA", 3) && data[3] >= '0' && data[3] <= '2') ||
+		!memcmp(data + 1, "ELF", 3) || !memcmp(data, "\xCF\xFA\xED\xFE", 4);
+}
+
+// 128-byte blocks, or 160 as the key S: lines hold them
+static vector<uint8_t> make_bin(const test_key_t& test_key, corpus_rng& rng)
+{
+	identity_t identity = make_identity(rng);
+
+	ida::id_t license_id;
+	make_license_id(license_id, 0x48, rng);
+
+	license_t license;
+	make_license(identity, license_id, static_cast<uint16_t>(ELicense_Named + rng.below(3)),
+		1, pick(k_key_versions, rng), rng, license);
+
+	vector<uint8_t> block(rng.below(2) ? 160 : sizeof(signature_t));
+	signature_t& sign = *reinterpret_cast<signature_t*>(block.data());
+	sign_license(test_key, license, rng, sign);
+	while (has_file_magic(block.data()))
+	{
+		license.keyNumber = static_cast<int16_t>(rng.next());
+		sign_license(test_key, license, rng, sign);
+	}
+	return block;
+}
+
+// HEXRAYS_VERSION text followed by the license as in pe modules,
+// or with the license CORPUS_POSIX_GAP bytes before the text as in posix ones
+static size_t get_rays_block_size(bool posix)
+{
+	return posix ? CORPUS_POSIX_GAP + sizeof(rays_signature_t) + sizeof(rays_license_t) :
+		sizeof(rays_signature_t) + sizeof(rays_license_t);
+}
+
+static void put_rays_block(uint8_t* data, bool posix, corpus_rng& rng)
+{
+	identity_t identity = make_identity(rng);
+
+	rays_license_t license;
+	memset(&license, 0, sizeof(rays_license_t));
+	license.flag1 = 0x01fe0000;
+	license.flag2 = 0x00010000;
+	license.creation = static_cast<uint32_t>(identity.issued);
+	license.support = static_cast<uint32_t>(identity.support);
+	make_license_id(license.plugin_id, pick(k_decompilers, rng).prefix, rng);
+	make_license_id(license.ida_id, 0x48, rng);
+
+	string name = identity.first + " " + identity.last + ", " + identity.company;
+	memcpy(license.name, name.data(), min(name.size(), sizeof(license.name) - 1));
+	for (size_t i = 0; i < 32; ++i)
+		license.md5[i] = "0123456789abcdef"[rng.below(16)];
+
+	rays_signature_t version;
+	memset(version, 0, sizeof(rays_signature_t));
+	string text = string("HEXRAYS_VERSION") + pick(k_rays_versions, rng);
+	memcpy(version, text.data(), text.size());
+
+	size_t text_offset = posix ? CORPUS_POSIX_GAP : 0;
+	size_t license_offset = posix ? 0 : sizeof(rays_signature_t);
+	if (posix)
+		memset(data + text_offset, 0, sizeof(rays_signature_t) + sizeof(rays_license_t));
+	memcpy(data + text_offset, version, sizeof(rays_signature_t));
+	memcpy(data + license_offset, &license, sizeof(rays_license_t));
+}
+
+// random section bytes with the license block somewhere in the data
+static void fill_sections(uint8_t* text, uint8_t* data, const corpus_options_t& options, bool posix,
+	corpus_rng& rng)
+{
+	rng.fill(text, options.text_size);
+	rng.fill(data, options.data_size);
+
+	size_t block = get_rays_block_size(posix);
+	size_t offset = options.offset;
+	if (offset == SIZE_MAX)
+		offset = rng.below(static_cast<uint32_t>((options.data_size - block) / 16 + 1)) * 16;
+	put_rays_block(data + offset, posix, rng);
+}
+
+// pe32+ dll, .text and .data
+static vector<uint8_t> make_pe(const corpus_options_t& options, corpus_rng& rng)
+{
+	const size_t headers = 0x400;
+	size_t text_raw = align_up(options.text_size, 0x200);
+	size_t data_raw = align_up(options.data_size, 0x200);
+	uint32_t text_rva = 0x1000;
+	uint32_t data_rva = static_cast<uint32_t>(text_rva + align_up(options.text_size, 0x1000));
+
+	vector<uint8_t> image(headers + text_raw + data_raw);
+	uint8_t* p = image.data();
+
+	put16(p, 0, 0x5a4d);				// MZ
+	put32(p, 0x3c, 0x80);				// e_lfanew
+	put32(p, 0x80, 0x00004550);			// PE
+
+	const size_t fh = 0x84;
+	put16(p, fh + 0, 0x8664);			// machine
+	put16(p, fh + 2, 2);				// sections
+	put32(p, fh + 4, static_cast<uint32_t>(rng.next()));
+	put16(p, fh + 16, 0xf0);			// optional header size
+	put16(p, fh + 18, 0x2022);			// executable, large address aware, dll
+
+	const size_t oh = fh + 20;
+	put16(p, oh + 0, 0x20b);			// pe32+
+	p[oh + 2] = 14;
+	put32(p, oh + 4, static_cast<uint32_t>(text_raw));
+	put32(p, oh + 8, static_cast<uint32_t>(data_raw));
+	put32(p, oh + 16, text_rva);		// entry point
+	put32(p, oh + 20, text_rva);
+	put64(p, oh + 24, 0x180000000ull);	// image base
+	put32(p, oh + 32, 0x1000);
+	put32(p, oh + 36, 0x200);
+	put16(p, oh + 40, 6);
+	put16(p, oh + 48, 6);
+	put32(p, oh + 56, static_cast<uint32_t>(data_rva + align_up(options.data_size, 0x1000)));
+	put32(p, oh + 60, headers);
+	put16(p, oh + 68, 2);				// gui
+	put16(p, oh + 70, 0x160);			// high entropy va, dynamic base, nx
+	put64(p, oh + 72, 0x100000);
+	put64(p, oh + 80, 0x1000);
+	put64(p, oh + 88, 0x100000);
+	put64(p, oh + 96, 0x1000);
+	put32(p, oh + 108, 16);				// data directories
+
+	const size_t sh = oh + 0xf0;
+	memcpy(p + sh, ".text", 5);
+	put32(p, sh + 8, static_cast<uint32_t>(options.text_size));
+	put32(p, sh + 12, text_rva);
+	put32(p, sh + 16, static_cast<uint32_t>(text_raw));
+	put32(p, sh + 20, headers);
+	put32(p, sh + 36, 0x60000020);		// code, execute, read
+
+	memcpy(p + sh + 40, ".data", 5);
+	put32(p, sh + 48, static_cast<uint32_t>(options.data_size));
+	put32(p, sh + 52, data_rva);
+	put32(p, sh + 56, static_cast<uint32_t>(data_raw));
+	put32(p, sh + 60, static_cast<uint32_t>(headers + text_raw));
+	put32(p, sh + 76, 0xc0000040);		// initialized data, read, write
+
+	fill_sections(p + headers, p + headers + text_raw, options, false, rng);
+	return image;
+}
+
+// elf64 x86-64 shared object, .text, .data and .shstrtab
+static vector<uint8_t> make_elf(const corpus_options_t& options, corpus_rng& rng)
+{
+	const char names[] = "\0.text\0.data\0.shstrtab";
+	const size_t text_off = 0x1000;
+	size_t data_off = align_up(text_off + options.text_size, 0x1000);
+	size_t names_off = data_off + options.data_size;
+	size_t sh_off = align_up(names_off + sizeof(names), 8);
+
+	vector<uint8_t> image(sh_off + 4 * 64);
+	uint8_t* p = image.data();
+
+	memcpy(p, "\x7f" "ELF", 4);
+	p[4] = 2;							// 64-bit
+	p[5] = 1;							// little-endian
+	p[6] = 1;
+	put16(p, 16, 3);					// shared object
+	put16(p, 18, 62);					// x86-64
+	put32(p, 20, 1);
+	put64(p, 24, text_off);				// entry
+	put64(p, 32, 64);					// program headers
+	put64(p, 40, sh_off);				// section headers
+	put16(p, 52, 64);
+	put16(p, 54, 56);
+	put16(p, 56, 2);
+	put16(p, 58, 64);
+	put16(p, 60, 4);
+	put16(p, 62, 3);					// .shstrtab
+
+	// r-x headers and code, rw- data
+	const size_t ph = 64;
+	put32(p, ph + 0, 1);
+	put32(p, ph + 4, 5);
+	put64(p, ph + 32, text_off + options.text_size);
+	put64(p, ph + 40, text_off + options.text_size);
+	put64(p, ph + 48, 0x1000);
+
+	put32(p, ph + 56 + 0, 1);
+	put32(p, ph + 56 + 4, 6);
+	put64(p, ph + 56 + 8, data_off);
+	put64(p, ph + 56 + 16, data_off);
+	put64(p, ph + 56 + 24, data_off);
+	put64(p, ph + 56 + 32, options.data_size);
+	put64(p, ph + 56 + 40, options.data_size);
+	put64(p, ph + 56 + 48, 0x1000);
+
+	memcpy(p + names_off, names, sizeof(names));
+
+	// null, .text, .data, .shstrtab
+	uint8_t* s = p + sh_off + 64;
+	put32(s, 0, 1);
+	put32(s, 4, 1);						// progbits
+	put64(s, 8, 6);						// alloc, exec
+	put64(s, 16, text_off);
+	put64(s, 24, text_off);
+	put64(s, 32, options.text_size);
+	put64(s, 48, 16);
+
+	s += 64;
+	put32(s, 0, 7);
+	put32(s, 4, 1);
+	put64(s, 8, 3);						// write, alloc
+	put64(s, 16, data_off);
+	put64(s, 24, data_off);
+	put64(s, 32, options.data_size);
+	put64(s, 48, 32);
+
+	s += 64;
+	put32(s, 0, 13);
+	put32(s, 4, 3);						// strtab
+	put64(s, 24, names_off);
+	put64(s, 32, sizeof(names));
+	put64(s, 48, 1);
+
+	fill_sections(p + text_off, p + data_off, options, true, rng);
+	return image;
+}
+
+// mach-o 64 x86-64 dylib, __TEXT,__text and __DATA,__data
+static vector<uint8_t> make_macho(const corpus_options_t& options, corpus_rng& rng)
+{
+	const size_t text_off = 0x1000;
+	size_t data_off = align_up(text_off + options.text_size, 0x1000);
+	const uint32_t segment_size = 72 + 80;
+
+	vector<uint8_t> image(data_off + options.data_size);
+	uint8_t* p = image.data();
+
+	put32(p, 0, 0xfeedfacf);
+	put32(p, 4, 0x01000007);			// x86-64
+	put32(p, 8, 3);
+	put32(p, 12, 6);					// dylib
+	put32(p, 16, 2);
+	put32(p, 20, 2 * segment_size);
+	put32(p, 24, 0x00100085);			// no undefs, dyld link, two level, no reexports
+
+	auto put_segment = [&](size_t at, const char* segment, const char* section, uint64_t fileoff,
+		uint64_t filesize, uint64_t offset, uint64_t size, uint32_t prot, uint32_t flags)
+	{
+		put32(p, at + 0, 0x19);			// LC_SEGMENT_64
+		put32(p, at + 4, segment_size);
+		strncpy(reinterpret_cast<char*>(p + at + 8), segment, 16);
+		put64(p, at + 24, fileoff);		// vmaddr
+		put64(p, at + 32, align_up(filesize, 0x1000));
+		put64(p, at + 40, fileoff);
+		put64(p, at + 48, filesize);
+		put32(p, at + 56, prot);
+		put32(p, at + 60, prot);
+		put32(p, at + 64, 1);
+
+		size_t sect = at + 72;
+		strncpy(reinterpret_cast<char*>(p + sect + 0), section, 16);
+		strncpy(reinterpret_cast<char*>(p + sect + 16), segment, 16);
+		put64(p, sect + 32, offset);	// addr
+		put64(p, sect + 40, size);
+		put32(p, sect + 48, static_cast<uint32_t>(offset));
+		put32(p, sect + 52, 4);
+		put32(p, sect + 64, flags);
+	};
+	put_segment(32, "__TEXT", "__text", 0, data_off, text_off, options.text_size, 5, 0x80000400);
+	put_segment(32 + segment_size, "__DATA", "__data", data_off, options.data_size, data_off,
+		options.data_size, 3, 0);
+
+	fill_sections(p + text_off, p + data_off, options, true, rng);
+	return image;
+}
+
+// id0 b-tree v1.6 with one leaf page of unshared keys, uncompressed,
+// the nodes check_idb_user reads
+static vector<uint8_t> make_idb(const test_key_t& test_key, corpus_rng& rng)
+{
+	const size_t page_size = 0x2000;
+	const uint32_t root = 0xff000001, loader = 0xff000002, original = 0xff000003, user1 = 0xff000004;
+
+	vector<pair<string, string>> records;
+	auto be32 = [](uint32_t v)
+	{
+		string s(4, 0);
+		for (size_t i = 0; i < 4; ++i) s[i] = static_cast<char>(v >> ((3 - i) * 8));
+		return s;
+	};
+	auto le32 = [](uint32_t v)
+	{
+		string s(4, 0);
+		for (size_t i = 0; i < 4; ++i) s[i] = static_cast<char>(v >> (i * 8));
+		return s;
+	};
+	auto name = [&](const char* text, uint32_t node) { records.emplace_back(string("N") + text, le32(node)); };
+	auto value = [&](uint32_t node, char tag, uint32_t index, const string& data)
+	{
+		records.emplace_back("." + be32(node) + tag + be32(index), data);
+	};
+
+	name("Root Node", root);
+	name("$ loader name", loader);
+	name("$ original user", original);
+
+	value(loader, 'S', 0, "pe.dll");
+	value(loader, 'S', 1, "Portable executable for AMD64 (PE)");
+
+	// idainfo: tag, version, processor name
+	string params("IDA\xbc\x02metapc", 11);
+	params.resize(64, 0);
+	value(root, 'S', 0x41b994, params);
+	value(root, 'A', static_cast<uint32_t>(-1), le32(700));
+	value(root, 'S', 1303, "7.0.0.170914");
+	value(root, 'A', static_cast<uint32_t>(-2), le32(static_cast<uint32_t>(make_identity(rng).issued)));
+	value(root, 'A', static_cast<uint32_t>(-5), le32(static_cast<uint32_t>(rng.next())));
+	string md5(16, 0);
+	rng.fill(&md5[0], md5.size());
+	value(root, 'S', 1302, md5);
+
+	// one in eight databases comes from a free or evaluation version
+	identity_t identity = make_identity(rng);
+	ida::id_t license_id;
+	make_license_id(license_id, 0x48, rng);
+
+	license_t license;
+	make_license(identity, license_id, ELicense_Named, 1, 700, rng, license);
+
+	// the evaluation block is the license shifted by a byte, its zero first
+	signature_t sign;
+	if (!rng.below(8))
+	{
+		const char* text = rng.below(2) ? "Evaluation version" : "Freeware version";
+		memset(&license, 0, sizeof(license_t));
+		memcpy(license.username, text, strlen(text));
+		memcpy(sign, reinterpret_cast<const uint8_t*>(&license) + 1, sizeof(license_t) - 1);
+		sign[sizeof(signature_t) - 1] = 0;
+	}
+	else
+		sign_license(test_key, license, rng, sign);
+
+	name("$ user1", user1);
+	value(original, 'S', 0, string(reinterpret_cast<const char*>(sign), sizeof(signature_t)));
+	value(user1, 'S', 0, string(reinterpret_cast<const char*>(&license) + 1, sizeof(license_t) - 1));
+	sort(records.begin(), records.end());
+
+	// header page, then the leaf page as the root
+	vector<uint8_t> id0(2 * page_size);
+	uint8_t* h = id0.data();
+	put16(h, 2, page_size);
+	put16(h, 4, 1);
+	put32(h, 6, static_cast<uint32_t>(records.size()));
+	put16(h, 10, 2);
+	memcpy(h + 13, "B-tree v 1.6 (C) Pol 1990", 25);
+
+	// entries from the top of the page, records from its end
+	uint8_t* leaf = id0.data() + page_size;
+	put16(leaf, 2, static_cast<uint16_t>(records.size()));
+	size_t top = page_size;
+	for (size_t i = 0; i < records.size(); ++i)
+	{
+		const string& key = records[i].first;
+		const string& data = records[i].second;
+		top -= 4 + key.size() + data.size();
+
+		put16(leaf, 4 + i * 6 + 4, static_cast<uint16_t>(top));
+		put16(leaf, top, static_cast<uint16_t>(key.size()));
+		memcpy(leaf + top + 2, key.data(), key.size());
+		put16(leaf, top + 2 + key.size(), static_cast<uint16_t>(data.size()));
+		memcpy(leaf + top + 4 + key.size(), data.data(), data.size());
+	}
+
+	// file header with the id0 offset only, then the section
+	const size_t header_size = 0x100;
+	vector<uint8_t> idb(header_size + 5 + id0.size());
+	memcpy(idb.data(), "IDA1", 4);
+	put32(idb.data(), 6, header_size);
+	put32(idb.data(), header_size + 1, static_cast<uint32_t>(id0.size()));
+	memcpy(idb.data() + header_size + 5, id0.data(), id0.size());
+	return idb;
+}
+
+static path get_corpus_path(const corpus_options_t& options, size_t type, size_t index)
+{
+	char shard[21], name[32]; // room for a full size_t
+	snprintf(shard, sizeof(shard), "%05zu", index / CORPUS_SHARD);
+	snprintf(name, sizeof(name), "%08zu%s", index, k_types[type].ext);
+	return options.output / k_types[type].name / shard / name;
+}
+
+static bool write_corpus_file(const path& filepath, const vector<uint8_t>& data)
+{
+	ofstream file(filepath, ios::binary | ios::trunc);
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	return file.good();
+}
+
+static bool make_file(const corpus_options_t& options, const test_key_t& key, size_t type, size_t index)
+{
+	corpus_rng rng(options.seed, type, index);
+	vector<uint8_t> data;
+
+	switch (type)
+	{
+	case ECorpusType_Key: data = make_key(key, rng); break;
+	case ECorpusType_Bin: data = make_bin(key, rng); break;
+	case ECorpusType_PE: data = make_pe(options, rng); break;
+	case ECorpusType_ELF: data = make_elf(options, rng); break;
+	case ECorpusType_MachO: data = make_macho(options, rng); break;
+	case ECorpusType_IDB: data = make_idb(key, rng); break;
+	}
+	return write_corpus_file(get_corpus_path(options, type, index), data);
+}
+
+// known moduli and the test one, for ida_key_checker -r
+static bool write_corpus_registry(const corpus_options_t& options, const test_key_t& key)
+{
+	vector<registry_entry_t> entries(2 + size(k_patch_mods));
+	make_registry_entry(entries[0], ida_rsa_mod, k_mont_official, "official");
+	for (size_t i = 0; i < size(k_patch_mods); ++i)
+		make_registry_entry(entries[i + 1], k_patch_mods[i], k_mont_patches[i], "patch_" + to_string(i + 1));
+
+	char name[32];
+	snprintf(name, sizeof(name), "test_%llx", static_cast<unsigned long long>(options.seed));
+	make_registry_entry(entries.back(), key.modulus, key.mont, name);
+	return write_registry(options.output / "registry.bin", entries.data(), entries.size());
+}
+
+static bool parse_types(const char* text, uint32_t& types)
+{
+	types = 0;
+	string list(text);
+	size_t begin = 0;
+	while (begin <= list.size())
+	{
+		size_t end = list.find(',', begin);
+		if (end == string::npos) end = list.size();
+		string item = list.substr(begin, end - begin);
+
+		size_t type = 0;
+		while (type < ECorpusType_Count && item != k_types[type].name) ++type;
+		if (type == ECorpusType_Count) return false;
+		types |= 1u << type;
+		begin = end + 1;
+	}
+	return types != 0;
+}
+
+int main(int argc, char* argv[])
+{
+	corpus_options_t options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		bool value = i + 1 < argc;
+		if (!strcmp(argv[i], "-o") && value)
+			options.output = argv[++i];
+		else if (!strcmp(argv[i], "-n") && value)
+			options.count = strtoull(argv[++i], nullptr, 0);
+		else if (!strcmp(argv[i], "-s") && value)
+			options.seed = strtoull(argv[++i], nullptr, 0);
+		else if (!strcmp(argv[i], "-j") && value)
+			options.threads = static_cast<unsigned>(strtoul(argv[++i], nullptr, 0));
+		else if (!strcmp(argv[i], "-t") && value && parse_types(argv[i + 1], options.types))
+			++i;
+		else if (!strcmp(argv[i], "--text-size") && value)
+			options.text_size = strtoull(argv[++i], nullptr, 0);
+		else if (!strcmp(argv[i], "--data-size") && value)
+			options.data_size = strtoull(argv[++i], nullptr, 0);
+		else if (!strcmp(argv[i], "--offset") && value)
+			options.offset = strtoull(argv[++i], nullptr, 0);
+		else
+		{
+			options.output.clear();
+			break;
+		}
+	}
+
+	// the posix block is the larger one, every shell must hold it where asked
+	size_t block = get_rays_block_size(true);
+	if (options.output.empty() || options.data_size < block ||
+		(options.offset != SIZE_MAX && options.offset > options.data_size - block))
+	{
+		fprintf(stderr, "usage: %s -o dir [-n count] [-s seed] [-j threads] [-t key,bin,pe,elf,macho,idb]\n"
+			"\t[--text-size n] [--data-size n] [--offset n]\n", argv[0]);
+		return 1;
+	}
+
+	// dates in the files do not depend on the host
+	set_time_zone({ ETimeZone_UTC, 0 });
+
+	test_key_t key;
+	if (!make_test_key(options.seed, key))
+	{
+		fprintf(stderr, "can't make the test key\n");
+		return 2;
+	}
+
+	vector<size_t> types;
+	for (size_t type = 0; type < ECorpusType_Count; ++type)
+	{
+		if (!(options.types & (1u << type))) continue;
+		types.push_back(type);
+
+		error_code ec;
+		for (size_t shard = 0; shard * CORPUS_SHARD < options.count; ++shard)
+			create_directories(get_corpus_path(options, type, shard * CORPUS_SHARD).parent_path(), ec);
+	}
+
+	if (!write_corpus_registry(options, key))
+	{
+		fprintf(stderr, "can't write %s\n", (options.output / "registry.bin").string().c_str());
+		return 2;
+	}
+
+	// every file is a job, workers take contiguous slices
+	size_t jobs = types.size() * options.count;
+	unsigned threads = options.threads ? options.threads : max(thread::hardware_concurrency(), 1u);
+	size_t workers = max<size_t>(min<size_t>(threads, jobs), 1);
+	atomic<size_t> failed(0);
+
+	vector<thread> pool;
+	pool.reserve(workers - 1);
+	size_t chunk = jobs / workers, rest = jobs % workers, begin = 0;
+	for (size_t w = 0; w < workers; ++w)
+	{
+		size_t end = begin + chunk + (w < rest ? 1 : 0);
+		auto job = [&, begin, end]()
+		{
+			for (size_t j = begin; j < end; ++j)
+				if (!make_file(options, key, types[j / options.count], j % options.count))
+					++failed;
+		};
+
+		// the calling thread takes the last slice
+		if (w + 1 == workers)
+			job();
+		else
+			pool.emplace_back(job);
+		begin = end;
+	}
+	for (auto& t : pool)
+		t.join();
+
+	printf("Seed:\t\t0x%llx\n", static_cast<unsigned long long>(options.seed));
+	printf("Files:\t\t%zu\n", jobs);
+	printf("Registry:\t%s\n", (options.output / "registry.bin").string().c_str());
+
+	if (failed || g_bad_signatures)
+	{
+		fprintf(stderr, "%zu files not written, %zu signatures do not decrypt\n",
+			failed.load(), g_bad_signatures.load());
+		return 3;
+	}
+	return 0;
+}
@@ -0,0 +1,24 @@
+/*
+* Secure crt names of the shared sources for the linux bench builds
+*
+* RnD, 2021
+*/
+
+#ifndef _BENCH_MSVC_COMPAT_H_
+#define _BENCH_MSVC_COMPAT_H_
+
+#ifndef _MSC_VER
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#define sscanf_s				sscanf
+#define sprintf_s				snprintf
+
+inline int localtime_s(struct tm* result, const time_t* time)
+{
+	return localtime_r(time, result) ? 0 : 1;
+}
+#endif
+
+#endif // _BENCH_MSVC_COMPAT_H_
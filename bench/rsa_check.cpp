@@ -0,0 +1,234 @@
+/*
+* Montgomery kernels against the bigint.c path on random blocks
+*
+* RnD, 2021
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ida_license.hpp"
+#include "ida_rsa_mont.hpp"
+#include "ida_rsa_builtin.hpp"
+#include "ida_cpu.hpp"
+#include "bigint.hpp"
+
+#define CHECK_SEED			0x13
+#define CHECK_MODULI		32
+#define CHECK_BLOCKS		64
+
+using namespace ida;
+using namespace std;
+
+typedef struct check_modulus_t
+{
+	string name;
+	signature_t modulus; // ida byte order
+	mont_modulus_t mont;
+} check_modulus_t;
+
+static uint64_t g_state = CHECK_SEED;
+
+// xorshift64
+static uint8_t next_byte()
+{
+	g_state ^= g_state << 13;
+	g_state ^= g_state >> 7;
+	g_state ^= g_state << 17;
+	return static_cast<uint8_t>(g_state >> 32);
+}
+
+// x^e mod n in a fresh bigint session, the reference for every kernel
+static void bigint_pow(const uint8_t* modulus, uint32_t exponent, const signature_t& sign,
+	license_t& license)
+{
+	signature_t mod, data;
+	memcpy(mod, modulus, sizeof(signature_t));
+	memcpy(data, sign, sizeof(signature_t));
+	reverse_block(mod, sizeof(signature_t));
+	reverse_block(data, sizeof(signature_t));
+
+	BI_CTX* BI = bi_initialize();
+	bi_set_mod(BI, bi_import(BI, mod, IDA_RSA_BLOCK_SIZE), BIGINT_M_OFFSET);
+
+	bigint* msg = bi_import(BI, data, IDA_RSA_BLOCK_SIZE);
+	bigint* emsg = bi_mod_power(BI, msg, int_to_bi(BI, exponent));
+	bi_export(BI, emsg, reinterpret_cast<uint8_t*>(&license), IDA_RSA_BLOCK_SIZE);
+
+	bi_free_mod(BI, BIGINT_M_OFFSET);
+	bi_terminate(BI);
+}
+
+// the built-in moduli, then random odd ones, some shorter than 1024 bits
+static vector<check_modulus_t> make_moduli()
+{
+	vector<check_modulus_t> mods;
+
+	auto add = [&](const string& name, const uint8_t* modulus)
+	{
+		check_modulus_t mod;
+		mod.name = name;
+		memcpy(mod.modulus, modulus, sizeof(signature_t));
+		mont_init(mod.mont, modulus);
+		mods.push_back(mod);
+	};
+
+	add("official", ida_rsa_mod);
+	for (size_t i = 0; i < std::size(k_patch_mods); ++i)
+		add("patch_" + to_string(i + 1), k_patch_mods[i]);
+
+	for (size_t i = 0; i < CHECK_MODULI; ++i)
+	{
+		signature_t modulus;
+		for (auto& b : modulus)
+			b = next_byte();
+		modulus[0] |= 1;
+		if (i % 4 == 3)
+			modulus[sizeof(signature_t) - 1] >>= 4;
+		else
+			modulus[sizeof(signature_t) - 1] |= 0x80;
+		add("random_" + to_string(i), modulus);
+	}
+	return mods;
+}
+
+// random blocks below and above the modulus, the top ones as large as a block gets
+static void make_blocks(const check_modulus_t& mod, signature_t* blocks)
+{
+	for (size_t i = 0; i < CHECK_BLOCKS; ++i)
+	{
+		signature_t& block = blocks[i];
+		for (auto& b : block)
+			b = next_byte();
+		block[0] |= 1;
+
+		if (i % 4 == 0)
+			block[sizeof(signature_t) - 1] = 0xff;
+		else if (i % 4 == 1)
+		{
+			// n + small, or n itself
+			memcpy(block, mod.modulus, sizeof(signature_t));
+			if (block[sizeof(signature_t) - 1] != 0xff)
+				block[0] = static_cast<uint8_t>(block[0] + (i & 0x0e));
+		}
+		else
+			block[sizeof(signature_t) - 1] &= 0x3f;
+	}
+}
+
+static size_t g_checks = 0, g_failed = 0;
+
+static void check(const char* kernel, const check_modulus_t& mod, uint32_t exponent, size_t block,
+	const license_t& expected, const license_t& license)
+{
+	++g_checks;
+	if (!memcmp(&expected, &license, sizeof(license_t))) return;
+	if (++g_failed <= 20)
+		printf("MISMATCH %-10s %-10s e=0x%x block %zu\n", kernel, mod.name.c_str(), exponent, block);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc > 1)
+	{
+		fprintf(stderr, "usage: %s\n", argv[0]);
+		return 1;
+	}
+
+	vector<EMontKernel> kernels = { EMontKernel_Scalar };
+	if (has_cpu_feature(ECpuFeature_AVX2)) kernels.push_back(EMontKernel_AVX2);
+	if (has_cpu_feature(ECpuFeature_AVX512IFMA)) kernels.push_back(EMontKernel_IFMA);
+	const char* names[] = { "scalar", "avx2", "ifma" };
+
+	const uint32_t exponents[] = { ida_rsa_pub, 3, 0x10001 };
+	vector<check_modulus_t> mods = make_moduli();
+	static signature_t blocks[CHECK_BLOCKS];
+
+	for (const auto& mod : mods)
+	{
+		make_blocks(mod, blocks);
+		for (uint32_t exponent : exponents)
+		{
+			vector<license_t> expected(CHECK_BLOCKS), licenses(CHECK_BLOCKS);
+			for (size_t i = 0; i < CHECK_BLOCKS; ++i)
+				bigint_pow(mod.modulus, exponent, blocks[i], expected[i]);
+
+			for (size_t i = 0; i < CHECK_BLOCKS; ++i)
+			{
+				mont_limbs_t x;
+				license_t license;
+
+				mont_import(x, blocks[i]);
+				mont_pow(x, x, exponent, mod.mont);
+				mont_export(x, reinterpret_cast<uint8_t*>(&license));
+				check("mont_pow", mod, exponent, i, expected[i], license);
+
+				if (exponent == ida_rsa_pub)
+				{
+					mont_import(x, blocks[i]);
+					mont_pow<ida_rsa_pub>(x, x, mod.mont);
+					mont_export(x, reinterpret_cast<uint8_t*>(&license));
+					check("mont_pow<>", mod, exponent, i, expected[i], license);
+				}
+
+				memset(&license, 0, sizeof(license_t));
+				mont_decrypt(mod.mont, exponent, blocks[i], license);
+				check("decrypt", mod, exponent, i, expected[i], license);
+			}
+
+			for (EMontKernel kernel : kernels)
+			{
+				memset(licenses.data(), 0, licenses.size() * sizeof(license_t));
+				mont_decrypt_batch(mod.mont, exponent, blocks, licenses.data(), nullptr,
+					CHECK_BLOCKS, kernel);
+				for (size_t i = 0; i < CHECK_BLOCKS; ++i)
+					check(names[kernel], mod, exponent, i, expected[i], licenses[i]);
+			}
+		}
+	}
+
+	// one block under every modulus, lanes with different moduli,
+	// the moduli below 2^1020 give licenses that decrypt, so the winner moves
+	vector<const mont_modulus_t*> lanes;
+	for (const auto& mod : mods)
+		lanes.push_back(&mod.mont);
+
+	for (size_t i = 0; i < mods.size(); ++i)
+	{
+		make_blocks(mods[i], blocks);
+		const signature_t& block = blocks[2];
+
+		int expected = -1;
+		license_t reference;
+		for (size_t j = i; j < mods.size() && expected < 0; ++j)
+		{
+			bigint_pow(mods[j].modulus, ida_rsa_pub, block, reference);
+			if (!reference.zero)
+				expected = static_cast<int>(j - i);
+		}
+
+		for (EMontKernel kernel : kernels)
+		{
+			license_t license;
+			int found = mont_decrypt_moduli(lanes.data() + i, lanes.size() - i, ida_rsa_pub, block,
+				license, kernel);
+			++g_checks;
+			if (found != expected || (found >= 0 && memcmp(&reference, &license, sizeof(license_t))))
+			{
+				if (++g_failed <= 20)
+					printf("MISMATCH %-10s %-10s moduli lane %d, expected %d\n", names[kernel],
+						mods[i].name.c_str(), found, expected);
+			}
+		}
+	}
+
+	printf("%zu checks over %zu moduli, kernels:", g_checks, mods.size());
+	for (EMontKernel kernel : kernels)
+		printf(" %s", names[kernel]);
+	printf(", %s\n", g_failed ? "MISMATCH" : "ok");
+	return g_failed ? 3 : 0;
+}
@@ -0,0 +1,156 @@
+/*
+* Marker search benchmark, boyer_moore_searcher against find_bytes
+*
+* RnD, 2021
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include "ida_rays_license.hpp"
+#include "ida_text.hpp"
+#include "ida_cpu.hpp"
+
+#define BENCH_SIZE			(32 << 20)
+#define BENCH_SEED			0x13
+
+using namespace ida;
+using namespace std;
+
+typedef struct bench_input_t
+{
+	string name;
+	vector<uint8_t> data;
+} bench_input_t;
+
+typedef struct bench_marker_t
+{
+	const char* name;
+	const uint8_t* pattern;
+	size_t length;
+} bench_marker_t;
+
+static const bench_marker_t k_markers[] = {
+	{ "version", ida_rays_version_text, sizeof(ida_rays_version_text) },
+	{ "sign", ida_rays_license_sign, sizeof(ida_rays_license_sign) },
+};
+
+// a module without the markers: random code, then zero-heavy data as in real plugins
+static bench_input_t generate_input()
+{
+	bench_input_t input = { "synthetic", vector<uint8_t>(BENCH_SIZE) };
+
+	uint64_t state = BENCH_SEED;
+	for (size_t i = 0; i < input.data.size(); ++i)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		uint8_t b = static_cast<uint8_t>(state >> 32);
+		input.data[i] = i < input.data.size() / 2 || b < 0x40 ? b : 0;
+	}
+	return input;
+}
+
+static bool load_input(const string& filepath, bench_input_t& input)
+{
+	ifstream file(filepath, ios::binary | ios::ate);
+	if (!file) return false;
+
+	input.name = filepath;
+	input.data.resize(static_cast<size_t>(file.tellg()));
+	file.seekg(0, ios::beg);
+	file.read(reinterpret_cast<char*>(input.data.data()), input.data.size());
+	return file.good();
+}
+
+// best of a few runs, MB/s
+template<typename F>
+static double run(const vector<uint8_t>& data, size_t runs, F search, size_t& found)
+{
+	double best = 0;
+	for (size_t i = 0; i < runs; ++i)
+	{
+		auto start = chrono::steady_clock::now();
+		found = search(data);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		best = max(best, data.size() / seconds / (1 << 20));
+	}
+	return best;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t runs = 5;
+	vector<bench_input_t> inputs;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			runs = strtoul(argv[++i], nullptr, 10);
+		else if (argv[i][0] == '-')
+		{
+			fprintf(stderr, "usage: %s [-n runs] [module...]\n", argv[0]);
+			return 1;
+		}
+		else
+		{
+			bench_input_t input;
+			if (!load_input(argv[i], input))
+			{
+				fprintf(stderr, "can't read %s\n", argv[i]);
+				return 2;
+			}
+			inputs.push_back(move(input));
+		}
+	}
+	if (!runs) runs = 1;
+	if (inputs.empty())
+		inputs.push_back(generate_input());
+
+#if defined(__linux__)
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(0, &cpus);
+	sched_setaffinity(0, sizeof(cpus), &cpus);
+#endif
+
+	const char* path = has_cpu_feature(ECpuFeature_AVX2) ? "avx2" :
+		has_cpu_feature(ECpuFeature_SSE2) ? "sse2" : "scalar";
+	printf("%-40s %-8s %12s %12s %8s  %s (%s)\n", "module", "marker", "offset", "bm MB/s", "MB/s", "check", path);
+
+	for (const auto& input : inputs)
+		for (const auto& marker : k_markers)
+		{
+			// the searcher is built per call, as every scan did
+			size_t bm_found, found;
+			double bm = run(input.data, runs, [&](const vector<uint8_t>& data)
+			{
+				auto it = search(data.begin(), data.end(),
+					boyer_moore_searcher(marker.pattern, marker.pattern + marker.length));
+				return static_cast<size_t>(it - data.begin());
+			}, bm_found);
+
+			double fast = run(input.data, runs, [&](const vector<uint8_t>& data)
+			{
+				return find_bytes(data.data(), data.size(), marker.pattern, marker.length);
+			}, found);
+
+			string name = input.name.size() > 40 ? "..." + input.name.substr(input.name.size() - 37) : input.name;
+			printf("%-40s %-8s %12zu %12.0f %8.0f  %s\n", name.c_str(), marker.name, found, bm, fast,
+				bm_found == found ? "ok" : "MISMATCH");
+		}
+	return 0;
+}
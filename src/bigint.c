@@ -77,11 +77,13 @@ static bigint *bi_int_multiply(BI_CTX *ctx, bigint *bi, comp i);
 static bigint *bi_int_divide(BI_CTX *ctx, bigint *biR, comp denom);
 static bigint *alloc(BI_CTX *ctx, int size);
 static bigint *trim(bigint *bi);
-static void more_comps(bigint *bi, int n);
+static void more_comps(BI_CTX *ctx, bigint *bi, int n);
+static bigint **alloc_window(BI_CTX *ctx, int k);
+static void free_window(BI_CTX *ctx, bigint **g);
 #if defined(CONFIG_BIGINT_KARATSUBA) || defined(CONFIG_BIGINT_BARRETT) || \
     defined(CONFIG_BIGINT_MONTGOMERY)
 static bigint *comp_right_shift(bigint *biR, int num_shifts);
-static bigint *comp_left_shift(bigint *biR, int num_shifts);
+static bigint *comp_left_shift(BI_CTX *ctx, bigint *biR, int num_shifts);
 #endif
 
 #ifdef CONFIG_BIGINT_CHECK_ON
@@ -139,6 +141,9 @@ void bi_terminate(BI_CTX *ctx)
 void bi_clear_cache(BI_CTX *ctx)
 {
     bigint *p, *pn;
+#ifdef CONFIG_BIGINT_POOL
+    bigint *slots = NULL;
+#endif
 
     if (ctx->free_list == NULL)
         return;
@@ -146,12 +151,46 @@ void bi_clear_cache(BI_CTX *ctx)
     for (p = ctx->free_list; p != NULL; p = pn)
     {
         pn = p->next;
+#ifdef CONFIG_BIGINT_POOL
+        if (p >= ctx->pool && p < ctx->pool + BIGINT_POOL_SIZE)
+        {
+            if (!p->pooled)     /* pool slot that outgrew its comps */
+            {
+                free(p->comps);
+                p->comps = ctx->pool_comps[p - ctx->pool];
+                p->max_comps = BIGINT_POOL_COMPS;
+                p->pooled = 1;
+            }
+
+            p->next = slots;
+            slots = p;
+            continue;
+        }
+#endif
         free(p->comps);
         free(p);
     }
 
     ctx->free_count = 0;
     ctx->free_list = NULL;
+
+#ifdef CONFIG_BIGINT_POOL
+    /* Free slots at the top go back behind the cursor, the ones below
+       a slot still in use stay on the free list. */
+    while (ctx->pool_used > 0 && ctx->pool[ctx->pool_used - 1].refs == 0)
+        ctx->pool_used--;
+
+    for (p = slots; p != NULL; p = pn)
+    {
+        pn = p->next;
+        if (p < ctx->pool + ctx->pool_used)
+        {
+            p->next = ctx->free_list;
+            ctx->free_list = p;
+            ctx->free_count++;
+        }
+    }
+#endif
 }
 
 /**
@@ -283,8 +322,8 @@ bigint *bi_add(BI_CTX *ctx, bigint *bia, bigint *bib)
     check(bib);
 
     n = max(bia->size, bib->size);
-    more_comps(bia, n+1);
-    more_comps(bib, n);
+    more_comps(ctx, bia, n+1);
+    more_comps(ctx, bib, n);
     pa = bia->comps;
     pb = bib->comps;
 
@@ -321,7 +360,7 @@ bigint *bi_subtract(BI_CTX *ctx,
     check(bia);
     check(bib);
 
-    more_comps(bib, n);
+    more_comps(ctx, bib, n);
     pa = bia->comps;
     pb = bib->comps;
 
@@ -427,7 +466,7 @@ bigint *bi_divide(BI_CTX *ctx, bigint *u, bigint *v, int is_mod)
 
     if (orig_u_size == u->size)  /* new digit position u0 */
     {
-        more_comps(u, orig_u_size + 1);
+        more_comps(ctx, u, orig_u_size + 1);
     }
 
     do
@@ -464,7 +503,7 @@ bigint *bi_divide(BI_CTX *ctx, bigint *u, bigint *v, int is_mod)
             int is_negative;
             tmp_u = bi_subtract(ctx, tmp_u, 
                     bi_int_multiply(ctx, bi_copy(v), q_dash), &is_negative);
-            more_comps(tmp_u, n+1);
+            more_comps(ctx, tmp_u, n+1);
 
             Q(j) = q_dash; 
 
@@ -585,7 +624,7 @@ static bigint *comp_right_shift(bigint *biR, int num_shifts)
 /**
  * Take each component and shift it up (in terms of components) 
  */
-static bigint *comp_left_shift(bigint *biR, int num_shifts)
+static bigint *comp_left_shift(BI_CTX *ctx, bigint *biR, int num_shifts)
 {
     int i = biR->size-1;
     comp *x, *y;
@@ -597,7 +636,7 @@ static bigint *comp_left_shift(bigint *biR, int num_shifts)
         return biR;
     }
 
-    more_comps(biR, biR->size + num_shifts);
+    more_comps(ctx, biR, biR->size + num_shifts);
 
     x = &biR->comps[i+num_shifts];
     y = &biR->comps[i];
@@ -760,8 +799,8 @@ void bi_set_mod(BI_CTX *ctx, bigint *bim, int mod_offset)
 
 #if defined(CONFIG_BIGINT_MONTGOMERY)
     /* set montgomery variables */
-    R = comp_left_shift(bi_clone(ctx, ctx->bi_radix), k-1);     /* R */
-    R2 = comp_left_shift(bi_clone(ctx, ctx->bi_radix), k*2-1);  /* R^2 */
+    R = comp_left_shift(ctx, bi_clone(ctx, ctx->bi_radix), k-1);     /* R */
+    R2 = comp_left_shift(ctx, bi_clone(ctx, ctx->bi_radix), k*2-1);  /* R^2 */
     ctx->bi_RR_mod_m[mod_offset] = bi_mod(ctx, R2);             /* R^2 mod m */
     ctx->bi_R_mod_m[mod_offset] = bi_mod(ctx, R);               /* R mod m */
 
@@ -772,7 +811,7 @@ void bi_set_mod(BI_CTX *ctx, bigint *bim, int mod_offset)
 
 #elif defined (CONFIG_BIGINT_BARRETT)
     ctx->bi_mu[mod_offset] = 
-        bi_divide(ctx, comp_left_shift(
+        bi_divide(ctx, comp_left_shift(ctx, 
             bi_clone(ctx, ctx->bi_radix), k*2-1), ctx->bi_mod[mod_offset], 0);
     bi_permanent(ctx->bi_mu[mod_offset]);
 #endif
@@ -909,8 +948,8 @@ static bigint *karatsuba(BI_CTX *ctx, bigint *bia, bigint *bib, int is_square)
     p1 = bi_subtract(ctx, 
             bi_subtract(ctx, p1, bi_copy(p2), NULL), bi_copy(p0), NULL);
 
-    comp_left_shift(p1, m);
-    comp_left_shift(p2, 2*m);
+    comp_left_shift(ctx, p1, m);
+    comp_left_shift(ctx, p2, 2*m);
     return bi_add(ctx, p1, bi_add(ctx, p0, p2));
 }
 #endif
@@ -1064,12 +1103,23 @@ int bi_compare(bigint *bia, bigint *bib)
 /*
  * Allocate and zero more components.  Does not consume bi. 
  */
-static void more_comps(bigint *bi, int n)
+static void more_comps(BI_CTX *ctx, bigint *bi, int n)
 {
     if (n > bi->max_comps)
     {
         bi->max_comps = max(bi->max_comps * 2, n);
+#ifdef CONFIG_BIGINT_POOL
+        if (bi->pooled)     /* outgrown its slot - move to the heap */
+        {
+            comp *comps = (comp*)malloc(bi->max_comps * COMP_BYTE_SIZE);
+            memcpy(comps, bi->comps, bi->size * COMP_BYTE_SIZE);
+            bi->comps = comps;
+            bi->pooled = 0;
+        }
+        else
+#endif
         bi->comps = (comp*)realloc(bi->comps, bi->max_comps * COMP_BYTE_SIZE);
+        ctx->heap_allocs++;
     }
 
     if (n > bi->size)
@@ -1103,14 +1153,30 @@ static bigint *alloc(BI_CTX *ctx, int size)
             abort();    /* create a stack trace from a core dump */
         }
 
-        more_comps(biR, size);
+        more_comps(ctx, biR, size);
     }
+#ifdef CONFIG_BIGINT_POOL
+    else if (ctx->pool_used < BIGINT_POOL_SIZE)
+    {
+        /* Take a fixed slot out of the context itself. */
+        biR = &ctx->pool[ctx->pool_used];
+        biR->comps = ctx->pool_comps[ctx->pool_used++];
+        biR->max_comps = BIGINT_POOL_COMPS;
+        biR->pooled = 1;
+        biR->size = 0;
+        more_comps(ctx, biR, size);
+    }
+#endif
     else
     {
         /* No free bigints available - create a new one. */
         biR = (bigint *)malloc(sizeof(bigint));
         biR->comps = (comp*)malloc(size * COMP_BYTE_SIZE);
         biR->max_comps = size;  /* give some space to spare */
+#ifdef CONFIG_BIGINT_POOL
+        biR->pooled = 0;
+#endif
+        ctx->heap_allocs += 2;
     }
 
     biR->size = size;
@@ -1227,7 +1293,7 @@ bigint *bi_mont(BI_CTX *ctx, bigint *bixy)
 
     do
     {
-        bixy = bi_add(ctx, bixy, comp_left_shift(
+        bixy = bi_add(ctx, bixy, comp_left_shift(ctx, 
                     bi_int_multiply(ctx, bim, bixy->comps[i]*mod_inv), i));
     } while (++i < n);
 
@@ -1301,6 +1367,33 @@ bigint *bi_barrett(BI_CTX *ctx, bigint *bi)
 }
 #endif /* CONFIG_BIGINT_BARRETT */
 
+/*
+ * Get storage for the exponentiation table. It lives in the context when 
+ * pooling is on.
+ */
+static bigint **alloc_window(BI_CTX *ctx, int k)
+{
+#ifdef CONFIG_BIGINT_POOL
+    if (k <= BIGINT_POOL_WINDOW)
+    {
+        return ctx->pool_g;
+    }
+#endif
+    ctx->heap_allocs++;
+    return (bigint **)malloc(k*sizeof(bigint *));
+}
+
+static void free_window(BI_CTX *ctx, bigint **g)
+{
+#ifdef CONFIG_BIGINT_POOL
+    if (g == ctx->pool_g)
+    {
+        return;
+    }
+#endif
+    free(g);
+}
+
 #ifdef CONFIG_BIGINT_SLIDING_WINDOW
 /*
  * Work out g1, g3, g5, g7... etc for the sliding-window algorithm 
@@ -1315,7 +1408,7 @@ static void precompute_slide_window(BI_CTX *ctx, int window, bigint *g1)
         k <<= 1;
     }
 
-    ctx->g = (bigint **)malloc(k*sizeof(bigint *));
+    ctx->g = alloc_window(ctx, k);
     ctx->g[0] = bi_clone(ctx, g1);
     bi_permanent(ctx->g[0]);
     g2 = bi_residue(ctx, bi_square(ctx, ctx->g[0]));   /* g^2 */
@@ -1369,7 +1462,7 @@ bigint *bi_mod_power(BI_CTX *ctx, bigint *bi, bigint *biexp)
     /* work out the slide constants */
     precompute_slide_window(ctx, window_size, bi);
 #else   /* just one constant */
-    ctx->g = (bigint **)malloc(sizeof(bigint *));
+    ctx->g = alloc_window(ctx, 1);
     ctx->g[0] = bi_clone(ctx, bi);
     ctx->window = 1;
     bi_permanent(ctx->g[0]);
@@ -1421,7 +1514,7 @@ bigint *bi_mod_power(BI_CTX *ctx, bigint *bi, bigint *biexp)
         bi_free(ctx, ctx->g[i]);
     }
 
-    free(ctx->g);
+    free_window(ctx, ctx->g);
     bi_free(ctx, bi);
     bi_free(ctx, biexp);
 #if defined CONFIG_BIGINT_MONTGOMERY
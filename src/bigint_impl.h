@@ -76,6 +76,16 @@ typedef uint64_t long_comp;     /**< A double precision component. */
 typedef int64_t slong_comp;     /**< A signed double precision component. */
 #endif
 
+#ifdef CONFIG_BIGINT_POOL
+#ifndef BIGINT_POOL_SIZE
+#define BIGINT_POOL_SIZE    48  /**< Bigints kept inside the context. */
+#endif
+#ifndef BIGINT_POOL_COMPS       /**< Room for a 2048x2048 bit product. */
+#define BIGINT_POOL_COMPS   (2*2048/COMP_BIT_SIZE + 8)
+#endif
+#define BIGINT_POOL_WINDOW  16  /**< Sliding-window table kept inside. */
+#endif
+
 /**
  * @struct  _bigint
  * @brief A big integer basic object
@@ -87,6 +97,9 @@ struct _bigint
     short max_comps;            /**< The heapsize allocated for this bigint */
     int refs;                   /**< An internal reference count. */
     comp* comps;                /**< A ptr to the actual component data */
+#ifdef CONFIG_BIGINT_POOL
+    uint8_t pooled;             /**< comps are a slot of the context pool */
+#endif
 };
 
 typedef struct _bigint bigint;  /**< An alias for _bigint */
@@ -114,6 +127,14 @@ typedef struct /**< A big integer "session" context. */
     int window;                 /**< The size of the sliding window */
     int active_count;           /**< Number of active bigints. */
     int free_count;             /**< Number of free bigints. */
+    int heap_allocs;            /**< malloc/realloc calls after creation. */
+
+#ifdef CONFIG_BIGINT_POOL
+    int pool_used;              /**< Pool slots handed out so far. */
+    bigint *pool_g[BIGINT_POOL_WINDOW];
+    bigint pool[BIGINT_POOL_SIZE];
+    comp pool_comps[BIGINT_POOL_SIZE][BIGINT_POOL_COMPS];
+#endif
 
 #ifdef CONFIG_BIGINT_MONTGOMERY
     uint8_t use_classical;      /**< Use classical reduction. */
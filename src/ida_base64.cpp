@@ -0,0 +1,190 @@
+/*
+* Non-throwing base64 decoder
+*
+* RnD, 2021
+*/
+
+#include <cstring>
+#include <algorithm>
+
+#include "ida_base64.hpp"
+#include "ida_cpu.hpp"
+
+#if defined(IDA_CPU_X86)
+#include <immintrin.h>
+#endif
+
+namespace ida
+{
+	const uint8_t k_bad = 0xff;
+
+	static inline uint8_t sextet(char c)
+	{
+		if (c >= 'A' && c <= 'Z') return static_cast<uint8_t>(c - 'A');
+		if (c >= 'a' && c <= 'z') return static_cast<uint8_t>(c - 'a' + 26);
+		if (c >= '0' && c <= '9') return static_cast<uint8_t>(c - '0' + 52);
+		if (c == '+' || c == '-') return 62;
+		if (c == '/' || c == '_') return 63;
+		return k_bad;
+	}
+
+	static inline bool is_padding(char c)
+	{
+		return c == '=' || c == '.';
+	}
+
+	static inline void put_byte(uint8_t* dst, size_t size, size_t& out, uint32_t value)
+	{
+		if (out < size) dst[out] = static_cast<uint8_t>(value);
+		++out;
+	}
+
+	// one chunk of up to 4 characters, padding ends the chunk early
+	// and decoding goes on with the next one, as base64_decode did
+	static EBase64 decode_chunk(string_view text, size_t pos, uint8_t* dst, size_t size, size_t& out)
+	{
+		if (pos + 1 >= text.size()) return EBase64_Truncated;
+
+		uint8_t v0 = sextet(text[pos]), v1 = sextet(text[pos + 1]);
+		if (v0 == k_bad || v1 == k_bad) return EBase64_BadChar;
+		put_byte(dst, size, out, (v0 << 2) | (v1 >> 4));
+
+		if (pos + 2 >= text.size() || is_padding(text[pos + 2])) return EBase64_Ok;
+		uint8_t v2 = sextet(text[pos + 2]);
+		if (v2 == k_bad) return EBase64_BadChar;
+		put_byte(dst, size, out, ((v1 & 0x0f) << 4) | (v2 >> 2));
+
+		if (pos + 3 >= text.size() || is_padding(text[pos + 3])) return EBase64_Ok;
+		uint8_t v3 = sextet(text[pos + 3]);
+		if (v3 == k_bad) return EBase64_BadChar;
+		put_byte(dst, size, out, ((v2 & 0x03) << 6) | v3);
+		return EBase64_Ok;
+	}
+
+	// 12 bytes a lane, clipped to the room left in dst
+	static inline void put_bytes(uint8_t* dst, size_t size, size_t& out, const uint8_t* bytes, size_t count)
+	{
+		if (out < size) memcpy(dst + out, bytes, min(count, size - out));
+		out += count;
+	}
+
+#if defined(IDA_CPU_X86)
+	// 16 characters to 12 bytes, false if any is not a plain sextet
+	IDA_TARGET("ssse3")
+	static bool ssse3_block(const char* text, uint8_t* bytes)
+	{
+		const __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text));
+
+		// range masks, bytes past 0x7f are negative and fall in none of them
+		const __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('A' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), in));
+		const __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('a' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), in));
+		const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('0' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), in));
+		const __m128i plus = _mm_cmpeq_epi8(in, _mm_set1_epi8('+'));
+		const __m128i minus = _mm_cmpeq_epi8(in, _mm_set1_epi8('-'));
+		const __m128i slash = _mm_cmpeq_epi8(in, _mm_set1_epi8('/'));
+		const __m128i under = _mm_cmpeq_epi8(in, _mm_set1_epi8('_'));
+
+		__m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, plus));
+		valid = _mm_or_si128(valid, _mm_or_si128(_mm_or_si128(minus, slash), under));
+		if (_mm_movemask_epi8(valid) != 0xffff) return false;
+
+		__m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+		shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+		shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+		shift = _mm_or_si128(shift, _mm_and_si128(plus, _mm_set1_epi8(62 - '+')));
+		shift = _mm_or_si128(shift, _mm_and_si128(minus, _mm_set1_epi8(62 - '-')));
+		shift = _mm_or_si128(shift, _mm_and_si128(slash, _mm_set1_epi8(63 - '/')));
+		shift = _mm_or_si128(shift, _mm_and_si128(under, _mm_set1_epi8(63 - '_')));
+		const __m128i values = _mm_add_epi8(in, shift);
+
+		// sextet pairs to 12 bits, 12-bit pairs to 24, then big endian bytes
+		const __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+		const __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+		const __m128i order = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), _mm_shuffle_epi8(words, order));
+		return true;
+	}
+
+	// 32 characters to 24 bytes, 12 in each lane
+	IDA_TARGET("avx2")
+	static bool avx2_block(const char* text, uint8_t* bytes)
+	{
+		const __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text));
+
+		const __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(in, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), in));
+		const __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(in, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), in));
+		const __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(in, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), in));
+		const __m256i plus = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('+'));
+		const __m256i minus = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('-'));
+		const __m256i slash = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('/'));
+		const __m256i under = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('_'));
+
+		__m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, plus));
+		valid = _mm256_or_si256(valid, _mm256_or_si256(_mm256_or_si256(minus, slash), under));
+		if (_mm256_movemask_epi8(valid) != -1) return false;
+
+		__m256i shift = _mm256_and_si256(upper, _mm256_set1_epi8(-'A'));
+		shift = _mm256_or_si256(shift, _mm256_and_si256(lower, _mm256_set1_epi8(26 - 'a')));
+		shift = _mm256_or_si256(shift, _mm256_and_si256(digit, _mm256_set1_epi8(52 - '0')));
+		shift = _mm256_or_si256(shift, _mm256_and_si256(plus, _mm256_set1_epi8(62 - '+')));
+		shift = _mm256_or_si256(shift, _mm256_and_si256(minus, _mm256_set1_epi8(62 - '-')));
+		shift = _mm256_or_si256(shift, _mm256_and_si256(slash, _mm256_set1_epi8(63 - '/')));
+		shift = _mm256_or_si256(shift, _mm256_and_si256(under, _mm256_set1_epi8(63 - '_')));
+		const __m256i values = _mm256_add_epi8(in, shift);
+
+		const __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+		const __m256i words = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+		const __m256i order = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+			2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+		const __m256i packed = _mm256_shuffle_epi8(words, order);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(bytes), _mm256_castsi256_si128(packed));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(bytes + 12), _mm256_extracti128_si256(packed, 1));
+		return true;
+	}
+#endif
+
+	EBase64 decode_base64(string_view text, uint8_t* dst, size_t size, size_t& decoded)
+	{
+		size_t pos = 0, out = 0;
+		decoded = 0;
+
+#if defined(IDA_CPU_X86)
+		// whole runs of plain sextets, anything else goes chunk by chunk below
+		uint8_t bytes[32];
+		if (has_cpu_feature(ECpuFeature_AVX2))
+		{
+			for (; pos + 32 <= text.size(); pos += 32)
+			{
+				if (avx2_block(text.data() + pos, bytes))
+				{
+					put_bytes(dst, size, out, bytes, 24);
+					continue;
+				}
+				for (size_t i = 0; i < 32; i += 4)
+					if (EBase64 status = decode_chunk(text, pos + i, dst, size, out))
+						return status;
+			}
+		}
+		if (has_cpu_feature(ECpuFeature_SSSE3))
+		{
+			for (; pos + 16 <= text.size(); pos += 16)
+			{
+				if (ssse3_block(text.data() + pos, bytes))
+				{
+					put_bytes(dst, size, out, bytes, 12);
+					continue;
+				}
+				for (size_t i = 0; i < 16; i += 4)
+					if (EBase64 status = decode_chunk(text, pos + i, dst, size, out))
+						return status;
+			}
+		}
+#endif
+		for (; pos < text.size(); pos += 4)
+			if (EBase64 status = decode_chunk(text, pos, dst, size, out))
+				return status;
+
+		decoded = out;
+		return EBase64_Ok;
+	}
+}
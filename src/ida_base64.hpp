@@ -0,0 +1,34 @@
+/*
+* Non-throwing base64 decoder header
+*
+* RnD, 2021
+*/
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _IDA_BASE64_HPP_
+#define _IDA_BASE64_HPP_
+
+#include <cstdint>
+#include <string_view>
+
+namespace ida
+{
+	using namespace std;
+
+	enum EBase64
+	{
+		EBase64_Ok = 0,
+		EBase64_BadChar,	// not in either alphabet, or padding where a value is needed
+		EBase64_Truncated,	// a single character in the last chunk
+	};
+
+	// decodes as base64_decode does, accepting both alphabets and '=' or '.' padding,
+	// at most size bytes go to dst but the whole text is checked,
+	// decoded is the full decoded length, on error dst holds a partial result
+	EBase64 decode_base64(string_view text, uint8_t* dst, size_t size, size_t& decoded);
+}
+
+#endif // _IDA_BASE64_HPP_
@@ -5,6 +5,7 @@
 */
 
 #include "ida_cnv_utils.hpp"
+#include "ida_date.hpp"
 
 namespace ida
 {
@@ -47,10 +48,10 @@ namespace ida
 		typedef struct pair_t
 		{
 			uint8_t id;
-			string product;
+			const char* product;
 		} pair_t;
 
-		vector<pair_t> k_pair = {
+		static constexpr pair_t k_pair[] = {
 			{ 0x50, "MIPS" },
 			{ 0x51, "MIPS" },
 			{ 0x52, "PPC64" },
@@ -109,29 +110,8 @@ namespace ida
 
 	string get_time(time_t time, bool extended)
 	{
-		if (time == 0) return "Never";
-
-		tm tms = { 0 };
-		localtime_s(&tms, &time);
-		char buff[24] = { 0 };
-
-		if (extended)
-		{
-			sprintf_s(buff, 24, "%04d-%02d-%02d %02d:%02d:%02d",
-				tms.tm_year + 1900,
-				tms.tm_mon + 1,
-				tms.tm_mday,
-				tms.tm_hour,
-				tms.tm_min,
-				tms.tm_sec);
-		}
-		else
-		{
-			sprintf_s(buff, 24, "%04d-%02d-%02d",
-				tms.tm_year + 1900,
-				tms.tm_mon + 1,
-				tms.tm_mday);
-		}
+		char buff[IDA_DATE_SIZE] = { 0 };
+		format_time(buff, sizeof(buff), time, extended, get_time_zone());
 		return buff;
 	}
 
@@ -164,31 +144,81 @@ namespace ida
 		return get_hex(reinterpret_cast<const uint8_t*>(value.data()), value.size());
 	}
 
-	time_t get_time(const string& value, bool extended)
+	time_t get_time(string_view value, bool extended)
 	{
-		bool isTime = false;
-		tm time;
-		memset(&time, 0, sizeof(tm));
+		return parse_time(value, extended, get_time_zone());
+	}
 
-		if (extended)
-		{
-			if (sscanf_s(value.c_str(), "%d-%d-%d %d:%d:%d",
-				&time.tm_year, &time.tm_mon, &time.tm_mday,
-				&time.tm_hour, &time.tm_min, &time.tm_sec) == 6)
-				isTime = true;
-		}
-		else
-		{
-			if (sscanf_s(value.c_str(), "%d-%d-%d",
-				&time.tm_year, &time.tm_mon, &time.tm_mday) == 3)
-				isTime = true;
-		}
-		if (isTime)
+	static inline bool is_space(char c)
+	{
+		return c == ' ' || (c >= '\t' && c <= '\r');
+	}
+
+	static inline int hex_digit(char c)
+	{
+		if (c >= '0' && c <= '9') return c - '0';
+		if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+		if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+		return -1;
+	}
+
+	void scan_spaces(string_view str, size_t& pos)
+	{
+		while (pos < str.size() && is_space(str[pos]))
+			++pos;
+	}
+
+	bool scan_char(string_view str, size_t& pos, char c)
+	{
+		if (pos >= str.size() || str[pos] != c) return false;
+		++pos;
+		return true;
+	}
+
+	bool scan_int(string_view str, size_t& pos, int& value)
+	{
+		scan_spaces(str, pos);
+
+		size_t p = pos;
+		bool negative = false;
+		if (p < str.size() && (str[p] == '-' || str[p] == '+'))
+			negative = str[p++] == '-';
+
+		size_t digits = p;
+		unsigned int result = 0;
+		while (p < str.size() && str[p] >= '0' && str[p] <= '9')
+			result = result * 10 + static_cast<unsigned int>(str[p++] - '0');
+		if (p == digits) return false;
+
+		value = static_cast<int>(negative ? 0u - result : result);
+		pos = p;
+		return true;
+	}
+
+	bool scan_hex(string_view str, size_t& pos, size_t width, int& value)
+	{
+		scan_spaces(str, pos);
+
+		size_t p = pos;
+		size_t end = str.size() - pos < width ? str.size() : pos + width;
+		bool negative = false;
+		if (p < end && (str[p] == '-' || str[p] == '+'))
+			negative = str[p++] == '-';
+
+		// a 0x prefix is taken even without digits after it, as the crt does
+		size_t digits = p;
+		if (end - p >= 2 && str[p] == '0' && (str[p + 1] == 'x' || str[p + 1] == 'X'))
 		{
-			time.tm_year -= 1900;
-			time.tm_mon--;
-			return mktime(&time);
+			digits = p + 1;
+			p += 2;
 		}
-		return 0;
+		unsigned int result = 0;
+		for (int d; p < end && (d = hex_digit(str[p])) >= 0; ++p)
+			result = result * 16 + static_cast<unsigned int>(d);
+		if (p == digits) return false;
+
+		value = static_cast<int>(negative ? 0u - result : result);
+		pos = p;
+		return true;
 	}
 }
\ No newline at end of file
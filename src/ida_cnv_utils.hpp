@@ -15,6 +15,7 @@
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <string_view>
 
 #include "ida_license.hpp"
 #include "ida_key.hpp"
@@ -28,6 +29,7 @@ namespace ida
 
 	string get_license_type(uint16_t type);
 	string get_license_id(const id_t& id);
+	// in the zone of set_time_zone
 	string get_time(time_t time, bool extended = false);
 	string get_string(const char* str, size_t limit);
 	string get_hex(const void* data, size_t size);
@@ -45,7 +47,17 @@ namespace ida
 		return str.str();
 	}
 
-	time_t get_time(const string& value, bool extended = false);
+	time_t get_time(string_view value, bool extended = false);
+
+	// sscanf-like readers over a view, pos moves past what they read
+	// any whitespace, as a space in a format does
+	void scan_spaces(string_view str, size_t& pos);
+	// exactly this char, no whitespace skipped
+	bool scan_char(string_view str, size_t& pos, char c);
+	// %d
+	bool scan_int(string_view str, size_t& pos, int& value);
+	// %<width>X, the sign counts toward the width
+	bool scan_hex(string_view str, size_t& pos, size_t width, int& value);
 }
 
 #endif // _IDA_CONVERSION_UTILS_HPP_
\ No newline at end of file
@@ -0,0 +1,89 @@
+/*
+* Runtime cpu features
+*
+* RnD, 2021
+*/
+
+#include "ida_cpu.hpp"
+
+#if defined(IDA_CPU_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace ida
+{
+#if defined(IDA_CPU_X86)
+	static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+	{
+#if defined(_MSC_VER)
+		int r[4];
+		__cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+		for (int i = 0; i < 4; ++i) regs[i] = static_cast<uint32_t>(r[i]);
+#else
+		__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	}
+
+	static uint64_t xgetbv0()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		uint32_t lo, hi;
+		__asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+		return (static_cast<uint64_t>(hi) << 32) | lo;
+#endif
+	}
+
+	static uint32_t detect_cpu_features()
+	{
+		uint32_t result = 0;
+		uint32_t regs[4];
+
+		cpuid(0, 0, regs);
+		uint32_t max_leaf = regs[0];
+		if (max_leaf < 1) return result;
+
+		cpuid(1, 0, regs);
+		if (regs[3] & (1u << 26)) result |= ECpuFeature_SSE2;
+		if (regs[2] & (1u << 9)) result |= ECpuFeature_SSSE3;
+		if (regs[2] & (1u << 20)) result |= ECpuFeature_SSE42;
+
+		// the os has to save the wide registers too
+		bool osxsave = (regs[2] & (1u << 27)) != 0;
+		uint64_t xcr0 = osxsave ? xgetbv0() : 0;
+		bool os_avx = (xcr0 & 0x06) == 0x06;
+		bool os_avx512 = (xcr0 & 0xe6) == 0xe6;
+
+		if (max_leaf < 7) return result;
+
+		cpuid(7, 0, regs);
+		if (os_avx && (regs[1] & (1u << 5))) result |= ECpuFeature_AVX2;
+		if (regs[1] & (1u << 8)) result |= ECpuFeature_BMI2;
+		if (os_avx512 &&
+			(regs[1] & (1u << 16)) &&	// F
+			(regs[1] & (1u << 30)) &&	// BW
+			(regs[1] & (1u << 31)))		// VL
+		{
+			result |= ECpuFeature_AVX512;
+			if (regs[1] & (1u << 21)) result |= ECpuFeature_AVX512IFMA;
+		}
+		return result;
+	}
+#else
+	static uint32_t detect_cpu_features()
+	{
+		return 0;
+	}
+#endif
+
+	uint32_t get_cpu_features()
+	{
+		static const uint32_t features = detect_cpu_features();
+		return features;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+/*
+* Runtime cpu features header
+*
+* RnD, 2021
+*/
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _IDA_CPU_HPP_
+#define _IDA_CPU_HPP_
+
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define IDA_CPU_X86
+#endif
+
+// gcc/clang need the instruction set enabled per function, msvc does not
+#if defined(IDA_CPU_X86) && (defined(__GNUC__) || defined(__clang__))
+#define IDA_TARGET(x)			__attribute__((target(x)))
+#else
+#define IDA_TARGET(x)
+#endif
+
+namespace ida
+{
+	enum ECpuFeature
+	{
+		ECpuFeature_SSE2 = 1 << 0,
+		ECpuFeature_SSSE3 = 1 << 1,
+		ECpuFeature_SSE42 = 1 << 2,
+		ECpuFeature_AVX2 = 1 << 3,
+		ECpuFeature_BMI2 = 1 << 4,
+		ECpuFeature_AVX512 = 1 << 5, // F + BW + VL
+		ECpuFeature_AVX512IFMA = 1 << 6,
+	};
+
+	// detected once, then cached
+	uint32_t get_cpu_features();
+
+	inline bool has_cpu_feature(ECpuFeature feature)
+	{
+		return (get_cpu_features() & feature) != 0;
+	}
+}
+
+#endif // _IDA_CPU_HPP_
\ No newline at end of file
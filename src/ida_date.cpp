@@ -0,0 +1,216 @@
+/*
+* Timezone-explicit date conversion
+*
+* RnD, 2021
+*/
+
+#include <cstring>
+
+#include "ida_date.hpp"
+#include "ida_cnv_utils.hpp"
+
+namespace ida
+{
+	static time_zone_t g_time_zone = { ETimeZone_Local, 0 };
+
+	void set_time_zone(const time_zone_t& zone)
+	{
+		g_time_zone = zone;
+	}
+
+	const time_zone_t& get_time_zone()
+	{
+		return g_time_zone;
+	}
+
+	bool parse_time_zone(string_view text, time_zone_t& zone)
+	{
+		if (text == "local")
+		{
+			zone = { ETimeZone_Local, 0 };
+			return true;
+		}
+		if (text == "utc" || text == "UTC")
+		{
+			zone = { ETimeZone_UTC, 0 };
+			return true;
+		}
+
+		// sign, two digit hours, optional colon and two digit minutes
+		if (text.size() < 3 || (text[0] != '+' && text[0] != '-')) return false;
+
+		int digits[4] = { 0 };
+		size_t count = 0;
+		for (size_t i = 1; i < text.size(); ++i)
+		{
+			if (text[i] == ':' && i == 3) continue;
+			if (text[i] < '0' || text[i] > '9' || count == 4) return false;
+			digits[count++] = text[i] - '0';
+		}
+		if (count != 2 && count != 4) return false;
+
+		int hours = digits[0] * 10 + digits[1];
+		int minutes = digits[2] * 10 + digits[3];
+		if (hours > 23 || minutes > 59) return false;
+
+		int32_t offset = (hours * 60 + minutes) * 60;
+		zone = { ETimeZone_Fixed, text[0] == '-' ? -offset : offset };
+		return true;
+	}
+
+	static inline int64_t floor_div(int64_t a, int64_t b)
+	{
+		return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+	}
+
+	// http://howardhinnant.github.io/date_algorithms.html
+	int64_t days_from_civil(int64_t year, int64_t month, int64_t day)
+	{
+		// months past december or before january move the year, as mktime does
+		year += floor_div(month - 1, 12);
+		month -= floor_div(month - 1, 12) * 12;
+
+		year -= month <= 2;
+		const int64_t era = floor_div(year, 400);
+		const int64_t yoe = year - era * 400;
+		const int64_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+		const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+		return era * 146097 + doe - 719468;
+	}
+
+	void civil_from_days(int64_t days, int64_t& year, unsigned& month, unsigned& day)
+	{
+		days += 719468;
+		const int64_t era = floor_div(days, 146097);
+		const int64_t doe = days - era * 146097;
+		const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+		const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+		const int64_t mp = (5 * doy + 2) / 153;
+
+		day = static_cast<unsigned>(doy - (153 * mp + 2) / 5 + 1);
+		month = static_cast<unsigned>(mp < 10 ? mp + 3 : mp - 9);
+		year = yoe + era * 400 + (month <= 2);
+	}
+
+	time_t parse_time(string_view value, bool extended, const time_zone_t& zone)
+	{
+		int year, month, day, hour = 0, minute = 0, second = 0;
+
+		size_t pos = 0;
+		bool isTime = scan_int(value, pos, year) && scan_char(value, pos, '-') &&
+			scan_int(value, pos, month) && scan_char(value, pos, '-') &&
+			scan_int(value, pos, day);
+
+		if (isTime && extended)
+		{
+			scan_spaces(value, pos);
+			isTime = scan_int(value, pos, hour) && scan_char(value, pos, ':') &&
+				scan_int(value, pos, minute) && scan_char(value, pos, ':') &&
+				scan_int(value, pos, second);
+		}
+		if (!isTime) return 0;
+
+		if (zone.mode == ETimeZone_Local)
+		{
+			tm time;
+			memset(&time, 0, sizeof(tm));
+			time.tm_year = year - 1900;
+			time.tm_mon = month - 1;
+			time.tm_mday = day;
+			time.tm_hour = hour;
+			time.tm_min = minute;
+			time.tm_sec = second;
+			return mktime(&time);
+		}
+
+		int64_t seconds = days_from_civil(year, month, day) * 86400 +
+			static_cast<int64_t>(hour) * 3600 + static_cast<int64_t>(minute) * 60 + second;
+		if (zone.mode == ETimeZone_Fixed)
+			seconds -= zone.offset;
+		return static_cast<time_t>(seconds);
+	}
+
+	// %0<width>d
+	static bool put_int(char* buff, size_t size, size_t& pos, int64_t value, size_t width)
+	{
+		char digits[24];
+		size_t count = 0;
+		uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+		do
+		{
+			digits[count++] = static_cast<char>('0' + magnitude % 10);
+			magnitude /= 10;
+		} while (magnitude);
+
+		size_t sign = value < 0 ? 1 : 0;
+		size_t zeros = width > count + sign ? width - count - sign : 0;
+		if (pos + sign + zeros + count >= size) return false;
+
+		if (sign) buff[pos++] = '-';
+		for (; zeros; --zeros) buff[pos++] = '0';
+		while (count) buff[pos++] = digits[--count];
+		return true;
+	}
+
+	static bool put_char(char* buff, size_t size, size_t& pos, char c)
+	{
+		if (pos + 1 >= size) return false;
+		buff[pos++] = c;
+		return true;
+	}
+
+	size_t format_time(char* buff, size_t size, time_t time, bool extended, const time_zone_t& zone)
+	{
+		if (!buff || !size) return 0;
+
+		if (time == 0)
+		{
+			const char never[] = "Never";
+			if (size < sizeof(never)) return 0;
+			memcpy(buff, never, sizeof(never));
+			return sizeof(never) - 1;
+		}
+
+		int64_t year;
+		unsigned month, day, hour, minute, second;
+
+		if (zone.mode == ETimeZone_Local)
+		{
+			tm tms = { 0 };
+			localtime_s(&tms, &time);
+			year = tms.tm_year + 1900;
+			month = tms.tm_mon + 1;
+			day = tms.tm_mday;
+			hour = tms.tm_hour;
+			minute = tms.tm_min;
+			second = tms.tm_sec;
+		}
+		else
+		{
+			int64_t seconds = static_cast<int64_t>(time) + (zone.mode == ETimeZone_Fixed ? zone.offset : 0);
+			int64_t days = floor_div(seconds, 86400);
+			int64_t rest = seconds - days * 86400;
+
+			civil_from_days(days, year, month, day);
+			hour = static_cast<unsigned>(rest / 3600);
+			minute = static_cast<unsigned>(rest / 60 % 60);
+			second = static_cast<unsigned>(rest % 60);
+		}
+
+		size_t pos = 0;
+		bool ok = put_int(buff, size, pos, year, 4) && put_char(buff, size, pos, '-') &&
+			put_int(buff, size, pos, month, 2) && put_char(buff, size, pos, '-') &&
+			put_int(buff, size, pos, day, 2);
+		if (ok && extended)
+		{
+			ok = put_char(buff, size, pos, ' ') &&
+				put_int(buff, size, pos, hour, 2) && put_char(buff, size, pos, ':') &&
+				put_int(buff, size, pos, minute, 2) && put_char(buff, size, pos, ':') &&
+				put_int(buff, size, pos, second, 2);
+		}
+		if (!ok) return 0;
+
+		buff[pos] = 0;
+		return pos;
+	}
+}
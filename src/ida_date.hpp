@@ -0,0 +1,56 @@
+/*
+* Timezone-explicit date conversion header
+*
+* RnD, 2021
+*/
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _IDA_DATE_HPP_
+#define _IDA_DATE_HPP_
+
+#include <cstdint>
+#include <ctime>
+#include <string_view>
+
+// "YYYY-MM-DD HH:MM:SS" and the terminating zero, wider years need more
+#define IDA_DATE_SIZE		24
+
+namespace ida
+{
+	using namespace std;
+
+	enum ETimeZone
+	{
+		ETimeZone_Local = 0,	// host rules through the crt, as keys were always shown
+		ETimeZone_UTC,
+		ETimeZone_Fixed,		// utc shifted by offset
+	};
+
+	typedef struct time_zone_t
+	{
+		ETimeZone mode;
+		int32_t offset; // seconds east of utc, fixed mode only
+	} time_zone_t;
+
+	// zone of get_time, set it once before any worker thread starts
+	void set_time_zone(const time_zone_t& zone);
+	const time_zone_t& get_time_zone();
+
+	// "local", "utc" or a fixed "+HH:MM", "-HHMM", "+HH"
+	bool parse_time_zone(string_view text, time_zone_t& zone);
+
+	// days since 1970-01-01 of a proleptic gregorian date, any month is normalized
+	int64_t days_from_civil(int64_t year, int64_t month, int64_t day);
+	void civil_from_days(int64_t days, int64_t& year, unsigned& month, unsigned& day);
+
+	// "%d-%d-%d" or "%d-%d-%d %d:%d:%d" in the zone, 0 if it does not parse
+	time_t parse_time(string_view value, bool extended, const time_zone_t& zone);
+	// "YYYY-MM-DD" or "YYYY-MM-DD HH:MM:SS", "Never" for 0, terminated,
+	// returns the length or 0 if buff is too small
+	size_t format_time(char* buff, size_t size, time_t time, bool extended, const time_zone_t& zone);
+}
+
+#endif // _IDA_DATE_HPP_
@@ -4,20 +4,101 @@
 * RnD, 2021
 */
 
+#include <thread>
+
 #include "ida_key.hpp"
 #include "md5.hpp"
 #include "base64.h"
+#include "ida_base64.hpp"
+#include "ida_mapped_file.hpp"
+#include "ida_text.hpp"
 
 namespace ida
 {
+	// part codes are upper case letters and digits
+	const size_t k_code_symbols = 36;
+	// longest part code, HEXARM64
+	const size_t k_code_size = 8;
+
+	constexpr int get_code_symbol(char c)
+	{
+		return c >= 'A' && c <= 'Z' ? c - 'A' : c >= '0' && c <= '9' ? c - '0' + 26 : -1;
+	}
+
 	typedef struct branding_t
 	{
 		uint8_t id;
-		string code;
-		string description;
+		const char* code;
+		const char* description;
 	} branding_t;
 
-	vector<branding_t> g_editions = {
+	// one set of code parts with a trie of the codes and an index of the ids,
+	// both built by the compiler, a code longer than k_code_size or with other
+	// characters than the symbols does not compile
+	template<size_t Count>
+	class brand_set
+	{
+	public:
+		constexpr brand_set(const branding_t (&set)[Count]) : m_set(set), m_next(), m_leaf(), m_index()
+		{
+			for (size_t i = 0; i < k_nodes; ++i)
+				m_leaf[i] = -1;
+			for (size_t i = 0; i < 256; ++i)
+				m_index[i] = -1;
+
+			size_t nodes = 1;
+			for (size_t i = 0; i < Count; ++i)
+			{
+				if (m_index[set[i].id] < 0)
+					m_index[set[i].id] = static_cast<int8_t>(i);
+
+				size_t node = 0;
+				for (const char* c = set[i].code; *c; ++c)
+				{
+					int symbol = get_code_symbol(*c);
+					if (!m_next[node][symbol])
+						m_next[node][symbol] = static_cast<uint8_t>(nodes++);
+					node = m_next[node][symbol];
+				}
+				m_leaf[node] = static_cast<int8_t>(i);
+			}
+		}
+
+		// null if the id is not in the set
+		const branding_t* find(uint8_t id) const
+		{
+			return m_index[id] < 0 ? nullptr : &m_set[m_index[id]];
+		}
+
+		// the longest code the text starts with, so HEXARM64 is not read as HEXARM
+		const branding_t* match(string_view text, size_t& length) const
+		{
+			const branding_t* found = nullptr;
+			size_t node = 0;
+			for (size_t i = 0; i < text.size(); ++i)
+			{
+				int symbol = get_code_symbol(text[i]);
+				if (symbol < 0 || !(node = m_next[node][symbol])) break;
+				if (m_leaf[node] >= 0)
+				{
+					found = &m_set[m_leaf[node]];
+					length = i + 1;
+				}
+			}
+			return found;
+		}
+
+	private:
+		static constexpr size_t k_nodes = Count * k_code_size + 1;
+		static_assert(k_nodes <= 256, "node numbers are bytes");
+
+		const branding_t* m_set;
+		uint8_t m_next[k_nodes][k_code_symbols]; // 0 is the root, never a child
+		int8_t m_leaf[k_nodes]; // entry whose code ends here
+		int8_t m_index[256]; // entry of an id
+	};
+
+	constexpr branding_t k_editions[] = {
 	{ EProduct_IDASTA, "IDASTA", "IDA Starter" },
 	{ EProduct_IDAADV, "IDAADV", "IDA Pro Advanced" },
 	{ EProduct_IDAPRO, "IDAPRO", "IDA Professional" },
@@ -37,35 +118,41 @@ namespace ida
 	{ EProduct_MIPS, "HEXMIPS", "MIPS Decompiler" },
 	};
 
-	vector<branding_t> g_licenses = {
+	constexpr branding_t k_licenses[] = {
 		{ ELicense_Named, "N", " Named License" },
 		{ ELicense_Computer, "C", " Computer License" },
 		{ ELicense_Floating, "F", " Floating License" },
 	};
 
-	vector<branding_t> g_platforms = {
+	constexpr branding_t k_platforms[] = {
 		{ EPlatform_Windows, "W", " (Windows)" },
 		{ EPlatform_Mac, "M", " (Mac)" },
 		{ EPlatform_Linux, "L", " (Linux)" },
 	};
 
-	string get_brand(const vector<branding_t>& set, uint8_t id, bool description)
+	constexpr brand_set g_editions(k_editions);
+	constexpr brand_set g_licenses(k_licenses);
+	constexpr brand_set g_platforms(k_platforms);
+
+	template<size_t Count>
+	const char* get_brand(const brand_set<Count>& set, uint8_t id, bool description)
 	{
-		for (const auto& val : set)
-			if (val.id == id)
-				return description ? val.description : val.code;
-		return "";
+		const branding_t* brand = set.find(id);
+		if (!brand) return "";
+		return description ? brand->description : brand->code;
 	}
 
-	const char* get_code_part(const vector<branding_t>& set, const char* code, uint8_t& id)
+	// an unknown part leaves id as it is and the code where it was
+	template<size_t Count>
+	string_view get_code_part(const brand_set<Count>& set, string_view code, uint8_t& id)
 	{
-		for (const auto& val : set)
-			if (!strncmp(code, val.code.c_str(), val.code.length()))
-			{
-				code += val.code.length();
-				id = val.id;
-				break;
-			}
+		size_t length;
+		const branding_t* brand = set.match(code, length);
+		if (brand)
+		{
+			code.remove_prefix(length);
+			id = brand->id;
+		}
 		return code;
 	}
 
@@ -80,181 +167,417 @@ namespace ida
 		return id;
 	}
 
-	product_code_t get_product_from_code(string code)
+	product_code_t get_product_from_code(string_view code)
 	{
 		product_code_t result;
-		const char* s = code.c_str();
-		s = get_code_part(g_editions, s, result.id);
-		s = get_code_part(g_licenses, s, result.license);
-		s = get_code_part(g_platforms, s, result.platform);
+		code = get_code_part(g_editions, code, result.id);
+		code = get_code_part(g_licenses, code, result.license);
+		code = get_code_part(g_platforms, code, result.platform);
 
 		return result;
 	}
 
-	const char* get_param_value(const char* line)
+	inline bool is_blank(char c)
 	{
-		if (!line) return nullptr;
+		return c == ' ' || c == '\t';
+	}
 
-		size_t p = 0;
+	// the text after the first run of blanks, the whole line if nothing follows one
+	string_view get_param_value(string_view line)
+	{
 		bool next_value = false;
 
-		for (size_t i = 0; i < strlen(line); ++i)
+		for (size_t i = 0; i < line.size(); ++i)
 		{
-			if (line[i] == ' ' || line[i] == '\t')
-			{
+			if (is_blank(line[i]))
 				next_value = true;
-			}
-			if (next_value && line[i] != ' ' && line[i] != '\t')
-			{
-				p = i;
-				break;
-			}
-		}
-		if (p)
-		{
-			return &line[p];
+			else if (next_value)
+				return line.substr(i);
 		}
 		return line;
 	}
 
-	inline string get_param_value(const string& line)
+	// the text up to the first blank, empty if there is none
+	inline string_view strip_value(string_view line)
 	{
-		const char* s = get_param_value(line.c_str());
-		if (!s) return "";
-		return string(s);
+		for (size_t i = 0; i < line.size(); ++i)
+			if (is_blank(line[i]))
+				return line.substr(0, i);
+		return string_view();
 	}
 
-	inline string strip_value(const string& line)
+	inline bool starts_with(string_view line, string_view prefix)
 	{
-		for (size_t i = 0; i < line.length(); ++i)
-			if (line[i] == ' ' || line[i] == '\t')
-				return line.substr(0, i);
-		return "";
+		return line.size() >= prefix.size() && !memcmp(line.data(), prefix.data(), prefix.size());
+	}
+
+	// "HEXRAYS_LICENSE %f"
+	bool parse_version(string_view line, uint16_t& version)
+	{
+		const string_view header = "HEXRAYS_LICENSE";
+		if (!starts_with(line, header)) return false;
+
+		// the number can not be longer than this, strtof wants a terminated copy
+		char number[64];
+		size_t size = min(line.size() - header.size(), sizeof(number) - 1);
+		memcpy(number, line.data() + header.size(), size);
+		number[size] = 0;
+
+		char* end = nullptr;
+		float fver = strtof(number, &end);
+		if (end == number) return false;
+
+		version = static_cast<uint16_t>(fver * 100. + .5);
+		return true;
+	}
+
+	// "%02X-%02X%02X-%02X%02X-%02X"
+	bool parse_license_id(string_view line, id_t& id)
+	{
+		int value;
+		size_t pos = 0;
+		for (size_t i = 0; i < sizeof(id_t); ++i)
+		{
+			// dashes before the 2nd, 4th and 6th byte
+			if ((i & 1) && !scan_char(line, pos, '-')) return false;
+			if (!scan_hex(line, pos, 2, value)) return false;
+			id[i] = static_cast<uint8_t>(value);
+		}
+		return true;
+	}
+
+	// the fields a product line can start with, %02X skips whitespace and takes a sign
+	inline bool is_product_lead(char c)
+	{
+		return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f') ||
+			c == '-' || c == '+' || c == ' ' || (c >= '\t' && c <= '\r');
 	}
 
+	// a malformed value leaves the field zero
 	void base_64_to_data(const string& base64, void* dst, size_t size)
 	{
-		string value;
-		try
+		size_t decoded;
+		if (decode_base64(base64, static_cast<uint8_t*>(dst), size, decoded) != EBase64_Ok)
+			memset(dst, 0, size);
+	}
+
+	// cr/lf handling of a line without its '\n', false if the line is skipped,
+	// cline ends at a zero byte, as c strings of the line did
+	bool normalize_line(string_view& line, string_view& cline)
+	{
+		if (!line.empty() && line[0] == '\r')
+			return false;
+
+		if (!line.empty() && line.back() == '\r')
+			line.remove_suffix(1);
+
+		cline = line;
+		const void* zero = memchr(line.data(), 0, line.size());
+		if (zero) cline = line.substr(0, static_cast<const char*>(zero) - line.data());
+		return true;
+	}
+
+	// md5 of the lines without their newlines, gathered into large updates
+	class md5_stream
+	{
+	public:
+		void init()
 		{
-			value = base64_decode(base64);
-			memcpy(dst, value.data(), value.size() > size ? size : value.size());
+			MD5_Init(&m_ctx);
+			m_used = 0;
 		}
-		catch (const std::exception&)
+
+		void update(const char* data, size_t size)
 		{
+			if (m_used + size > sizeof(m_buff))
+			{
+				flush();
+				if (size >= sizeof(m_buff))
+				{
+					MD5_Update(&m_ctx, data, static_cast<unsigned long>(size));
+					return;
+				}
+			}
+			memcpy(m_buff + m_used, data, size);
+			m_used += size;
 		}
-	}
 
-	bool parse_key(path filepath, key_t& key)
-	{
-		key = key_t();
-		bool result = false;
+		void final(unsigned char* digest)
+		{
+			flush();
+			MD5_Final(digest, &m_ctx);
+		}
 
-		ifstream file(filepath, ios::binary);
-		if (!file.is_open()) return false;
+	private:
+		void flush()
+		{
+			if (m_used) MD5_Update(&m_ctx, m_buff, static_cast<unsigned long>(m_used));
+			m_used = 0;
+		}
 
-		bool isKey = false;
-		bool isEnded = false;
+		MD5_CTX m_ctx;
+		size_t m_used;
+		char m_buff[4096];
+	};
 
-		string line;
-		string value;
-		string rnd;
-		string sign;
-		size_t len;
-		int id0, id1, id2, id3, id4, id5;
+	// one key fed line by line
+	class key_parser
+	{
+	public:
+		key_parser() { reset(); }
 
-		MD5_CTX md5_ctx;
-		MD5_Init(&md5_ctx);
+		void reset()
+		{
+			m_key = key_t();
+			m_is_key = false;
+			m_is_ended = false;
+			m_rnd.clear();
+			m_sign.clear();
+			m_md5.init();
+		}
 
-		while (getline(file, line))
+		// a header line once a key has started, bundles end the key before it
+		bool is_next_key(string_view line) const
 		{
-			len = line.length();
+			uint16_t version;
+			string_view cline;
+			return m_is_key && normalize_line(line, cline) &&
+				!cline.empty() && cline[0] == 'H' && parse_version(cline, version);
+		}
 
-			if (len && line[0] == '\r')
-				continue;
+		void feed(string_view line);
+		// false if no key header was seen
+		bool finish(key_t& key);
+
+	private:
+		key_t m_key;
+		bool m_is_key;
+		bool m_is_ended;
+		string m_rnd;
+		string m_sign;
+		md5_stream m_md5;
+	};
 
-			if (len && line[len - 1] == '\r')
-				line.erase(len - 1);
+	void key_parser::feed(string_view line)
+	{
+		string_view cline;
+		if (!normalize_line(line, cline)) return;
 
-			float fver = 0.0;
-			if (sscanf_s(line.c_str(), "HEXRAYS_LICENSE %f", &fver) == 1)
-			{
-				key.version = static_cast<uint16_t>(fver * 100. + .5);
-				isKey = true;
-			}
-			if (!isKey) continue;
+		if (!cline.empty() && cline[0] == 'H' && parse_version(cline, m_key.version))
+			m_is_key = true;
+		if (!m_is_key) return;
 
-			if (line.find("USER") == 0)
+		switch (line.empty() ? 0 : line[0])
+		{
+		case 'U':
+			if (starts_with(line, "USER"))
+				m_key.username = get_param_value(cline);
+			break;
+		case 'E':
+			if (starts_with(line, "EMAIL"))
+				m_key.email = get_param_value(cline);
+			break;
+		case 'I':
+			if (starts_with(line, "ISSUED_ON"))
+				m_key.issued = get_time(get_param_value(cline), true);
+			break;
+		// Seller data?
+		case 'R':
+			if (starts_with(line, "R:"))
+				m_rnd.append(line.substr(2));
+			break;
+		// Signature
+		case 'S':
+			if (starts_with(line, "S:"))
 			{
-				key.username = get_param_value(line);
+				if (!m_is_ended) m_is_ended = true;
+				m_sign.append(line.substr(2));
 			}
-			if (line.find("EMAIL") == 0)
+			break;
+		}
+
+		// Product line
+		product_t product;
+		if (!cline.empty() && is_product_lead(cline[0]) && parse_license_id(cline, product.licenseId))
+		{
+			int value;
+			// product
+			string_view val = get_param_value(cline);
+			product.product = get_product_from_code(strip_value(val));
+			// count
+			val = get_param_value(val);
+			size_t pos = 0;
+			if (scan_int(strip_value(val), pos, value))
+				product.count = value;
+			// support
+			val = get_param_value(val);
+			product.support = get_time(strip_value(val));
+			// expires
+			val = get_param_value(val);
+			product.expires = get_time(strip_value(val));
+
+			m_key.products.push_back(product);
+		}
+		if (!m_is_ended) m_md5.update(line.data(), line.size());
+	}
+
+	bool key_parser::finish(key_t& key)
+	{
+		if (!m_is_key) return false;
+
+		m_md5.final(m_key.md5);
+
+		base_64_to_data(m_rnd, m_key.rnd, sizeof(rnd_t));
+		base_64_to_data(m_sign, m_key.signature, sizeof(signature_t));
+
+		key = move(m_key);
+		return true;
+	}
+
+	// complete lines of text, the rest is left for the next call
+	template<typename F>
+	size_t split_lines(const char* text, size_t size, bool last, F&& on_line)
+	{
+		// newlines are found a batch at a time, key lines are short
+		size_t ends[256];
+		size_t begin = 0;
+		while (begin < size)
+		{
+			size_t base = begin, scanned;
+			size_t count = find_newlines(text + base, size - base, ends, sizeof(ends) / sizeof(ends[0]), scanned);
+			for (size_t i = 0; i < count; ++i)
 			{
-				key.email = get_param_value(line);
+				size_t end = base + ends[i];
+				if (!on_line(string_view(text + begin, end - begin))) return size;
+				begin = end + 1;
 			}
-			if (line.find("ISSUED_ON") == 0)
+			if (base + scanned < size) continue;
+
+			if (last && begin < size)
 			{
-				value = get_param_value(line);
-				key.issued = get_time(value, true);
+				if (!on_line(string_view(text + begin, size - begin))) return size;
+				begin = size;
 			}
-			// Product line
-			if (sscanf_s(line.c_str(), "%02X-%02X%02X-%02X%02X-%02X",
-				&id0, &id1, &id2, &id3, &id4, &id5) == 6)
+			break;
+		}
+		return begin;
+	}
+
+	bool parse_key(const uint8_t* data, size_t size, key_t& key)
+	{
+		key_parser parser;
+		split_lines(reinterpret_cast<const char*>(data), size, true,
+			[&](string_view line) { parser.feed(line); return true; });
+
+		if (!parser.finish(key))
+		{
+			key = key_t();
+			return false;
+		}
+		return true;
+	}
+
+	bool parse_key(path filepath, key_t& key)
+	{
+		mapped_file file;
+		if (!file.open(filepath)) return false;
+
+		return parse_key(file.data(), file.size(), key);
+	}
+
+	// the bundle state between buffers
+	class key_bundle
+	{
+	public:
+		key_bundle(const key_callback_t& callback) : m_callback(callback), m_count(0), m_stop(false) {}
+
+		// false once the callback stopped the walk
+		bool line(string_view line)
+		{
+			if (m_parser.is_next_key(line) && !emit()) return false;
+			m_parser.feed(line);
+			return true;
+		}
+
+		size_t finish()
+		{
+			if (!m_stop) emit();
+			return m_count;
+		}
+
+	private:
+		bool emit()
+		{
+			key_t key;
+			if (m_parser.finish(key))
 			{
-				product_t product;
-
-				product.licenseId[0] = static_cast<uint8_t>(id0);
-				product.licenseId[1] = static_cast<uint8_t>(id1);
-				product.licenseId[2] = static_cast<uint8_t>(id2);
-				product.licenseId[3] = static_cast<uint8_t>(id3);
-				product.licenseId[4] = static_cast<uint8_t>(id4);
-				product.licenseId[5] = static_cast<uint8_t>(id5);
-
-				// product
-				const char* val = get_param_value(line.c_str());
-				value = strip_value(val);
-				product.product = get_product_from_code(value);
-				// count
-				val = get_param_value(val);
-				value = strip_value(val);
-				if (sscanf_s(value.c_str(), "%d", &id0) == 1)
-					product.count = id0;
-				// support
-				val = get_param_value(val);
-				value = strip_value(val);
-				product.support = get_time(value);
-				// expires
-				val = get_param_value(val);
-				value = strip_value(val);
-				product.expires = get_time(value);
-
-				key.products.push_back(product);
+				++m_count;
+				m_stop = !m_callback(key);
 			}
-			// Seller data?
-			if (line.find("R:") == 0)
+			m_parser.reset();
+			return !m_stop;
+		}
+
+		const key_callback_t& m_callback;
+		key_parser m_parser;
+		size_t m_count;
+		bool m_stop;
+	};
+
+	size_t parse_keys(const uint8_t* data, size_t size, const key_callback_t& callback)
+	{
+		key_bundle bundle(callback);
+		split_lines(reinterpret_cast<const char*>(data), size, true,
+			[&](string_view line) { return bundle.line(line); });
+		return bundle.finish();
+	}
+
+	size_t parse_keys(path filepath, const key_callback_t& callback, size_t window)
+	{
+		ifstream file(filepath, ios::binary);
+		if (!file.is_open()) return 0;
+
+		key_bundle bundle(callback);
+		vector<char> buffer(max<size_t>(window ? window : IDA_KEY_WINDOW, IDA_KEY_LINE_MAX));
+		size_t used = 0;
+		bool stopped = false, skip = false;
+
+		while (!stopped && file)
+		{
+			file.read(buffer.data() + used, buffer.size() - used);
+			used += static_cast<size_t>(file.gcount());
+
+			// the rest of a line longer than the buffer is dropped up to its newline
+			size_t done = 0;
+			if (skip)
 			{
-				rnd.append(line.substr(2));
+				const char* end = static_cast<const char*>(memchr(buffer.data(), '\n', used));
+				if (!end)
+				{
+					used = 0;
+					continue;
+				}
+				done = static_cast<size_t>(end - buffer.data()) + 1;
+				skip = false;
 			}
-			// Signature
-			if (line.find("S:") == 0)
+
+			bool last = !file;
+			done += split_lines(buffer.data() + done, used - done, last,
+				[&](string_view line) { stopped = !bundle.line(line); return !stopped; });
+
+			// a full buffer without a newline, no key line is that long
+			if (!done && used == buffer.size())
 			{
-				if (!isEnded) isEnded = true;
-				sign.append(line.substr(2));
+				skip = true;
+				used = 0;
+				continue;
 			}
-			if (!isEnded) MD5_Update(&md5_ctx, line.c_str(), line.length());
-		}
-		if (isKey)
-		{
-			MD5_Final(key.md5, &md5_ctx);
 
-			base_64_to_data(rnd, key.rnd, sizeof(rnd_t));
-			base_64_to_data(sign, key.signature, sizeof(signature_t));
-
-			return true;
+			// the unfinished line moves to the front
+			memmove(buffer.data(), buffer.data() + done, used - done);
+			used -= done;
 		}
-		file.close();
-
-		return result;
+		return bundle.finish();
 	}
 
 	void print_key(const key_t& key, bool print_header)
@@ -328,63 +651,241 @@ namespace ida
 		return str.str();
 	}
 
-	ELicenseState get_hexrays_license(path filepath, string& version, rays_license_t& license)
+	// first offset of pattern in [begin, end), the file is read through buffer
+	// and each window keeps the last length - 1 bytes of the previous one
+	static bool find_in_file(ifstream& file, uint64_t begin, uint64_t end, const uint8_t* pattern,
+		size_t length, vector<uint8_t>& buffer, uint64_t& found)
 	{
-		ifstream file(filepath, ios::binary);
-		if (!file.is_open()) return ELicenseState_AccessError;
+		file.clear();
+		file.seekg(static_cast<streamoff>(begin), ios::beg);
+		if (!file) return false;
 
-		file.seekg(0, ios::end);
-		auto size = file.tellg();
-		file.seekg(0, ios::beg);
-		
-		// this is definitely not a plug-in module
-		if (size > 10000000) return ELicenseState_NotFound;
+		uint64_t base = begin; // file offset of buffer[0]
+		size_t used = 0;
 
-		std::vector<uint8_t> bin;
-		bin.resize(size);
-		file.read(reinterpret_cast<char*>(bin.data()), bin.size());
+		while (base + used < end)
+		{
+			size_t count = static_cast<size_t>(min<uint64_t>(buffer.size() - used, end - base - used));
+			file.read(reinterpret_cast<char*>(buffer.data() + used), count);
+			count = static_cast<size_t>(file.gcount());
+			if (!count) break;
+			used += count;
+
+			size_t offset = find_bytes(buffer.data(), used, pattern, length);
+			if (offset != used)
+			{
+				found = base + offset;
+				return true;
+			}
 
-		// HEXRAYS_VERSION
-		vector<uint8_t> text(cbegin(ida_rays_version_text), cend(ida_rays_version_text));
-		vector<uint8_t> sign(cbegin(ida_rays_license_sign), cend(ida_rays_license_sign));
-		
-		// search
-		auto it = std::search(bin.begin(), bin.end(), boyer_moore_searcher(text.begin(), text.end()));
-		if (it == bin.end()) return ELicenseState_NotFound;
+			// a match across the edge starts in the kept tail
+			size_t keep = min(used, length - 1);
+			memmove(buffer.data(), buffer.data() + used - keep, keep);
+			base += used - keep;
+			used = keep;
+		}
+		return false;
+	}
 
-		auto offset = it - bin.begin();
+	// first offset of pattern at or after begin, a match does not span two ranges
+	static bool find_in_ranges(ifstream& file, const vector<file_range_t>& ranges, uint64_t begin,
+		const uint8_t* pattern, size_t length, vector<uint8_t>& buffer, uint64_t& found)
+	{
+		for (const auto& range : ranges)
+		{
+			uint64_t end = range.offset + range.size;
+			if (end > begin && find_in_file(file, max(begin, range.offset), end, pattern, length, buffer, found))
+				return true;
+		}
+		return false;
+	}
+
+	// [base, end) outside the sorted ranges, widened by overlap into them,
+	// so a match across the edge of a range is found
+	static vector<file_range_t> get_gaps(const vector<file_range_t>& ranges, uint64_t base, uint64_t end,
+		uint64_t overlap)
+	{
+		vector<file_range_t> gaps;
+		auto add = [&](uint64_t from, uint64_t to)
+		{
+			if (from >= to) return;
+			from = from - base > overlap ? from - overlap : base;
+			to = end - to > overlap ? to + overlap : end;
+			if (!gaps.empty() && from <= gaps.back().offset + gaps.back().size)
+				gaps.back().size = to - gaps.back().offset;
+			else
+				gaps.push_back({ from, to - from });
+		};
+
+		uint64_t from = base;
+		for (const auto& range : ranges)
+		{
+			add(from, range.offset);
+			from = range.offset + range.size;
+		}
+		add(from, end);
+		return gaps;
+	}
+
+	static size_t read_at(ifstream& file, uint64_t offset, void* data, size_t size)
+	{
+		file.clear();
+		file.seekg(static_cast<streamoff>(offset), ios::beg);
+		file.read(reinterpret_cast<char*>(data), size);
+		return static_cast<size_t>(file.gcount());
+	}
 
-		// the block cannot be at the end of the file
-		if (offset + sizeof(rays_signature_t) + sizeof(rays_license_t) > bin.size())
+	// license of the module in [base, base + size) of the file
+	static ELicenseState find_hexrays_license(ifstream& file, uint64_t base, uint64_t size, size_t window,
+		string& version, rays_license_t& license)
+	{
+		uint64_t end = base + size;
+
+		// the only buffer, whatever the module size
+		vector<uint8_t> buffer(max<size_t>(window, sizeof(rays_signature_t)));
+
+		// data sections first, the whole module when the headers do not parse
+		vector<file_range_t> ranges;
+		if (!get_data_ranges(file, base, size, ranges))
+			ranges.assign(1, { base, size });
+
+		// a packed or patched module can keep a marker outside the data sections,
+		// a miss there searches the rest of the module, every byte is read once
+		auto find = [&](uint64_t begin, const uint8_t* pattern, size_t length, uint64_t& found)
+		{
+			return find_in_ranges(file, ranges, begin, pattern, length, buffer, found) ||
+				find_in_ranges(file, get_gaps(ranges, base, end, length - 1), begin, pattern, length, buffer, found);
+		};
+
+		// HEXRAYS_VERSION
+		uint64_t offset;
+		if (!find(base, ida_rays_version_text, sizeof(ida_rays_version_text), offset))
 			return ELicenseState_NotFound;
 
+		// the block cannot be at the end of the module
+		if (offset + sizeof(rays_signature_t) + sizeof(rays_license_t) > end)
+			return ELicenseState_NotFound;
+
+		uint8_t block[sizeof(rays_signature_t) + sizeof(rays_license_t)];
+		if (read_at(file, offset, block, sizeof(block)) != sizeof(block))
+			return ELicenseState_AccessError;
+
 		// default
 		version = "HEXRAYS_VERSION";
 		memset(&license, 0, sizeof(rays_license_t));
 
-		const char* ver = reinterpret_cast<char*>(bin.data() + offset);
+		const char* ver = reinterpret_cast<const char*>(block);
 		// zero-end str guarantee
 		version = get_string(ver, sizeof(rays_signature_t));
 
 		// license payload
-		rays_license_t* lic = reinterpret_cast<rays_license_t*>(bin.data() + offset + sizeof(rays_signature_t));
-		if (lic->flag1 != 0x01fe0000 && lic->flag2 != 0x00010000)
+		rays_license_t lic;
+		memcpy(&lic, block + sizeof(rays_signature_t), sizeof(rays_license_t));
+		if (lic.flag1 != 0x01fe0000 && lic.flag2 != 0x00010000)
 		{
-			// for posix bin's
-			it = std::search(bin.begin() + offset - 400, bin.end(), boyer_moore_searcher(sign.begin(), sign.end()));
-			if (it == bin.end()) return ELicenseState_Corrupted;
-			lic = reinterpret_cast<rays_license_t*>(bin.data() + (it - bin.begin()));
+			// for posix bin's, the search starts at most 400 bytes before the text
+			uint64_t found;
+			if (!find(offset > base + 400 ? offset - 400 : base,
+				ida_rays_license_sign, sizeof(ida_rays_license_sign), found))
+				return ELicenseState_Corrupted;
+
+			// a sign close to the end gives a partial license, the rest is zero
+			memset(&lic, 0, sizeof(rays_license_t));
+			read_at(file, found, &lic, static_cast<size_t>(min<uint64_t>(sizeof(rays_license_t), end - found)));
 		}
 		// copy
-		memcpy(&license, lic, sizeof(rays_license_t));
+		memcpy(&license, &lic, sizeof(rays_license_t));
 
 		// post check
 		if (ver[31] != 0 ||
-			lic->creation == 0 || lic->support == 0 ||
-			lic->name[0] == 0 || lic->md5[0] == 0 ||
-			lic->plugin_id[0] == 0 ||  lic->ida_id[0] == 0)
+			lic.creation == 0 || lic.support == 0 ||
+			lic.name[0] == 0 || lic.md5[0] == 0 ||
+			lic.plugin_id[0] == 0 ||  lic.ida_id[0] == 0)
 			return ELicenseState_Corrupted;
 
 		return ELicenseState_Ok;
 	}
-}
\ No newline at end of file
+
+	ELicenseState get_hexrays_license(path filepath, string& version, rays_license_t& license, size_t window)
+	{
+		ifstream file(filepath, ios::binary);
+		if (!file.is_open()) return ELicenseState_AccessError;
+
+		file.seekg(0, ios::end);
+		uint64_t size = static_cast<uint64_t>(file.tellg());
+
+		return find_hexrays_license(file, 0, size, window, version, license);
+	}
+
+	ELicenseState get_hexrays_licenses(path filepath, vector<rays_slice_t>& slices, size_t window)
+	{
+		slices.clear();
+
+		ifstream file(filepath, ios::binary);
+		if (!file.is_open()) return ELicenseState_AccessError;
+
+		file.seekg(0, ios::end);
+		uint64_t size = static_cast<uint64_t>(file.tellg());
+
+		// a thin module is one slice of the whole file
+		vector<module_slice_t> modules;
+		if (!get_fat_slices(file, size, modules))
+			modules.assign(1, { 0, 0, 0, size });
+
+		slices.resize(modules.size());
+		for (size_t i = 0; i < modules.size(); ++i)
+		{
+			slices[i].slice = modules[i];
+			slices[i].state = ELicenseState_NotFound;
+			memset(&slices[i].license, 0, sizeof(rays_license_t));
+		}
+
+		// a thin module or a universal one with a single usable slice, within its bounds
+		if (slices.size() == 1)
+			slices[0].state = find_hexrays_license(file, slices[0].slice.offset, slices[0].slice.size, window,
+				slices[0].version, slices[0].license);
+		else
+		{
+			file.close();
+
+			// every worker has its own stream and buffer, slices do not share bytes
+			size_t workers = min<size_t>(max(thread::hardware_concurrency(), 1u), slices.size());
+			vector<thread> pool;
+			pool.reserve(workers - 1);
+
+			size_t chunk = slices.size() / workers, rest = slices.size() % workers, begin = 0;
+			for (size_t w = 0; w < workers; ++w)
+			{
+				size_t end = begin + chunk + (w < rest ? 1 : 0);
+				auto job = [=, &slices]()
+				{
+					ifstream slice_file(filepath, ios::binary);
+					for (size_t i = begin; i < end; ++i)
+					{
+						auto& slice = slices[i];
+						slice.state = !slice_file.is_open() ? ELicenseState_AccessError :
+							find_hexrays_license(slice_file, slice.slice.offset, slice.slice.size, window,
+								slice.version, slice.license);
+					}
+				};
+
+				// the calling thread takes the last slices
+				if (w + 1 == workers)
+					job();
+				else
+					pool.emplace_back(job);
+				begin = end;
+			}
+			for (auto& t : pool)
+				t.join();
+		}
+
+		// the best of the slices
+		ELicenseState state = slices[0].state;
+		for (const auto& slice : slices)
+			if (slice.state == ELicenseState_Ok ||
+				(slice.state == ELicenseState_Corrupted && state != ELicenseState_Ok))
+				state = slice.state;
+		return state;
+	}
+}
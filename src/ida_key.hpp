@@ -15,6 +15,7 @@
 #include <cstdio>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <iomanip> 
 #include <fstream>
@@ -24,10 +25,15 @@
 #include "ida_license.hpp"
 #include "ida_rays_license.hpp"
 #include "ida_cnv_utils.hpp"
+#include "ida_module.hpp"
 
 #undef max
 #undef min
 
+#define IDA_KEY_WINDOW		(1 << 20)
+#define IDA_KEY_LINE_MAX	4096		// longer lines of a bundle are skipped
+#define IDA_RAYS_WINDOW		(1 << 20)
+
 namespace ida
 {
 	using namespace std;
@@ -108,7 +114,7 @@ namespace ida
 		rnd_t rnd; // random?
 		signature_t signature;
 
-		key_t() : version(0)
+		key_t() : version(0), issued(0)
 		{
 			memset(&md5, 0, sizeof(md5_t));
 			memset(&rnd, 0, sizeof(rnd_t));
@@ -118,16 +124,40 @@ namespace ida
 
 	// parse ida.key
 	bool parse_key(path filepath, key_t& key);
+	// same from a mapped or preloaded buffer, no copy of the lines
+	bool parse_key(const uint8_t* data, size_t size, key_t& key);
+
+	// keys of a bundle one at a time, a new key starts at each HEXRAYS_LICENSE line,
+	// false from the callback stops, returns the number of keys passed to it
+	typedef function<bool(const key_t& key)> key_callback_t;
+	size_t parse_keys(const uint8_t* data, size_t size, const key_callback_t& callback);
+	// read in windows of at least IDA_KEY_LINE_MAX, memory stays at the window,
+	// a line that does not fit is skipped
+	size_t parse_keys(path filepath, const key_callback_t& callback, size_t window = IDA_KEY_WINDOW);
 
 	void print_key(const key_t& key, bool print_header = true);
 	string print_key_view(const key_t& key, bool print_sign = false);
 
 	// utils
 	string get_product_string(const product_code_t& product, bool description = false);
-	product_code_t get_product_from_code(string code);
+	product_code_t get_product_from_code(string_view code);
 
-	// hexrays license
-	ELicenseState get_hexrays_license(path filepath, string& version, rays_license_t& license);
+	// hexrays license, the module is streamed through a window of fixed size
+	ELicenseState get_hexrays_license(path filepath, string& version, rays_license_t& license,
+		size_t window = IDA_RAYS_WINDOW);
+
+	typedef struct rays_slice_t
+	{
+		module_slice_t slice; // cputype 0 for a thin module
+		ELicenseState state;
+		string version;
+		rays_license_t license;
+	} rays_slice_t;
+
+	// hexrays license of every slice of a universal mach-o, scanned concurrently,
+	// or of a thin module as one slice, returns the best state of them
+	ELicenseState get_hexrays_licenses(path filepath, vector<rays_slice_t>& slices,
+		size_t window = IDA_RAYS_WINDOW);
 }
 
 #endif // _IDA_KEY_HPP_
\ No newline at end of file
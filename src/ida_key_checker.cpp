@@ -22,7 +22,15 @@
 #include <cxxopts.hpp>
 
 #include "ida_key.hpp"
-#include "ida_rsa_patches.h"
+#include "ida_rsa.hpp"
+#include "ida_rsa_registry.hpp"
+#include "ida_rsa_cache.hpp"
+#include "ida_rsa_builtin.hpp"
+#include "ida_rsa_scan.hpp"
+#include "ida_mapped_file.hpp"
+#include "ida_date.hpp"
+#include "ida_text.hpp"
+#include "ida_markers.hpp"
 
 #if defined(WIN32) && defined(UNICODE)
 #define file_path(x)	get_file_path(x)	
@@ -71,42 +79,64 @@ bool write_file(const path& path, const void* data, size_t size)
 	return false;
 }
 
-// Decrypt signature
-bool decrypt_sign(const signature_t& sign, license_t& license, bool& is_pirated)
+// Modulus trial mode for decrypt_sign
+static ERsaTrial g_rsa_trial = ERsaTrial_Interleaved;
+
+// Key files hold several concatenated keys
+static bool g_key_bundle = false;
+
+// Known moduli from -r, the built-in ones otherwise
+static rsa_registry g_registry;
+
+// Built-in moduli, constants computed at compile time
+vector<registry_entry_t> get_builtin_moduli()
 {
-	bool is_sign_decrypted = false;
-	is_pirated = true;
+	vector<registry_entry_t> entries(1 + size(k_patch_mods));
+	make_registry_entry(entries[0], ida_rsa_mod, k_mont_official, "official");
+	for (size_t i = 0; i < size(k_patch_mods); ++i)
+		make_registry_entry(entries[i + 1], k_patch_mods[i], k_mont_patches[i],
+			"patch_" + to_string(i + 1));
+	return entries;
+}
 
-	if (decrypt_signature(sign, license))
-	{
-		is_sign_decrypted = true;
-		is_pirated = false;
-	}
-	else
+shared_ptr<const rsa_verifier> get_verifier()
+{
+	shared_ptr<const rsa_verifier> verifier = g_registry.verifier();
+	if (verifier) return verifier;
+
+	static shared_ptr<const rsa_verifier> builtin = []()
 	{
-		// check pirated versions
-		for (const auto& mod : k_patch_mods)
-			if (decrypt_signature(sign, license, mod))
-			{
-				is_sign_decrypted = true;
-				break;
-			}
-	}
-	return is_sign_decrypted;
+		shared_ptr<rsa_verifier> result = make_shared<rsa_verifier>();
+		for (auto& entry : get_builtin_moduli())
+			result->add(entry.modulus, entry.mont, entry.name, entry.exponent);
+		return result;
+	}();
+	return builtin;
 }
 
-// Check key file
-int check_key_file(path ida_key_file, path signature_file = "")
+// Decrypted signatures from -c, shared with other runs
+static rsa_cache g_cache;
+
+// Decrypt signature
+bool decrypt_sign(const signature_t& sign, license_t& license, bool& is_pirated)
 {
-	cout << endl << "Key file: " << ida_key_file << endl;
+	shared_ptr<const rsa_verifier> verifier = get_verifier();
+	cache_entry_t entry;
 
-	key_t key;
-	if (!parse_key(ida_key_file, key))
-	{
-		cout << "Invalid or legacy license." << endl;
-		return 3;
-	}
+	// most matched moduli first, all at once unless sequential
+	if (g_cache.is_open())
+		g_cache.decrypt(*verifier, &sign, &entry, 1, g_rsa_trial);
+	else
+		decrypt_entry(*verifier, sign, entry, g_rsa_trial);
 
+	memcpy(&license, &entry.license, sizeof(license_t));
+	is_pirated = (entry.flags & ECacheFlag_Pirated) != 0;
+	return (entry.flags & ECacheFlag_Decrypted) != 0;
+}
+
+// Check parsed key
+int check_parsed_key(const key_t& key, path signature_file = "")
+{
 	bool is_sign_decrypted = false;
 	bool is_pirated = true;
 	bool is_valid_md5 = false;
@@ -156,6 +186,52 @@ int check_key_file(path ida_key_file, path signature_file = "")
 	return 0;
 }
 
+// Check key file
+int check_key_file(path ida_key_file, path signature_file = "")
+{
+	cout << endl << "Key file: " << ida_key_file << endl;
+
+	key_t key;
+	if (!parse_key(ida_key_file, key))
+	{
+		cout << "Invalid or legacy license." << endl;
+		return 3;
+	}
+	return check_parsed_key(key, signature_file);
+}
+
+// Check every key of a bundle, outputs get the key number
+int check_key_bundle(path bundle_file, path signature_file = "")
+{
+	cout << endl << "Key bundle: " << bundle_file << endl;
+
+	size_t index = 0;
+	size_t count = parse_keys(bundle_file, [&](const key_t& key)
+	{
+		path output;
+		if (!signature_file.empty())
+		{
+			// the number goes before the extension, check_parsed_key replaces only that
+			output = signature_file.parent_path() /
+				(signature_file.stem().string() + "_" + to_string(++index) + signature_file.extension().string());
+		}
+		else
+			++index;
+
+		cout << endl << "Key #" << index << endl;
+		check_parsed_key(key, output);
+		return true;
+	});
+
+	if (!count)
+	{
+		cout << "Invalid or legacy license." << endl;
+		return 3;
+	}
+	cout << endl << "Keys:" << '\t' << '\t' << count << endl;
+	return 0;
+}
+
 int check_idb_user(path idb_database, path signature_file = "")
 {
 	try
@@ -353,32 +429,14 @@ int check_signature(path bin_file, path decrypted_file = "")
 	return 0;
 }
 
-int check_hexrays_plugin(path bin_file, path bin_license = "")
+// version line and license of one module, the block is saved when bin_license is set
+static void print_hexrays_slice(const rays_slice_t& slice, path bin_license)
 {
-	string version;
-	string ver;
-	rays_license_t license;
-	auto result = get_hexrays_license(bin_file, version, license);
-
-	if (result != ELicenseState_Ok && result != ELicenseState_Corrupted)
-	{
-		switch (result)
-		{
-		case ida::ELicenseState_AccessError:
-			cout << "Access error to file: " << bin_file << endl;
-			break;
-		case ida::ELicenseState_NotFound:
-			cout << "License block not found." << endl;
-			break;
-		default:
-			break;
-		}
-		return 2;
-	}
-	ver = version;
+	string version = slice.version;
+	string ver = version;
 	version.insert(version.begin() + 15, ' ');
-	cout << version << (result == ELicenseState_Corrupted ? "\t(Corrupted)" : "") << endl << endl;
-	print_rays_license(license);
+	cout << version << (slice.state == ELicenseState_Corrupted ? "\t(Corrupted)" : "") << endl << endl;
+	print_rays_license(slice.license);
 
 	if (!bin_license.empty())
 	{
@@ -386,8 +444,8 @@ int check_hexrays_plugin(path bin_file, path bin_license = "")
 		vector<uint8_t> block;
 		block.insert(block.begin(), ver.cbegin(), ver.cend());
 		block.insert(block.end(),
-			reinterpret_cast<uint8_t*>(&license),
-			reinterpret_cast<uint8_t*>(&license) + sizeof(rays_license_t));
+			reinterpret_cast<const uint8_t*>(&slice.license),
+			reinterpret_cast<const uint8_t*>(&slice.license) + sizeof(rays_license_t));
 
 		cout << endl << "Save HexRays license block to: " << bin_license << endl;
 		if (!write_file(bin_license, block.data(), block.size()))
@@ -395,7 +453,70 @@ int check_hexrays_plugin(path bin_file, path bin_license = "")
 		else
 			cout << "License block saved" << endl;
 	}
-	return 0;
+}
+
+static void print_hexrays_error(ELicenseState state, path bin_file)
+{
+	switch (state)
+	{
+	case ida::ELicenseState_AccessError:
+		cout << "Access error to file: " << bin_file << endl;
+		break;
+	case ida::ELicenseState_NotFound:
+		cout << "License block not found." << endl;
+		break;
+	default:
+		break;
+	}
+}
+
+int check_hexrays_plugin(path bin_file, path bin_license = "")
+{
+	vector<rays_slice_t> slices;
+	auto result = get_hexrays_licenses(bin_file, slices);
+
+	// thin module, a universal one is printed slice by slice even with one usable slice
+	bool thin = slices.size() == 1 && !slices[0].slice.cputype;
+	if (result != ELicenseState_Ok && result != ELicenseState_Corrupted && thin)
+	{
+		print_hexrays_error(result, bin_file);
+		return 2;
+	}
+
+	if (thin)
+	{
+		print_hexrays_slice(slices[0], bin_license);
+		return 0;
+	}
+
+	// universal mach-o, every slice has its own license and block file
+	for (size_t i = 0; i < slices.size(); ++i)
+	{
+		const auto& slice = slices[i];
+		string cpu = get_cpu_name(slice.slice.cputype, slice.slice.cpusubtype);
+
+		cout << (i ? "\n" : "") << "Slice:\t\t" << cpu << " at 0x" << hex << slice.slice.offset << dec << endl;
+		if (slice.state != ELicenseState_Ok && slice.state != ELicenseState_Corrupted)
+		{
+			print_hexrays_error(slice.state, bin_file);
+			continue;
+		}
+
+		// slices of the same cpu name also get their index
+		path slice_license = bin_license;
+		if (!slice_license.empty())
+		{
+			slice_license += "." + cpu;
+			for (size_t j = 0; j < slices.size(); ++j)
+				if (j != i && get_cpu_name(slices[j].slice.cputype, slices[j].slice.cpusubtype) == cpu)
+				{
+					slice_license += "." + to_string(i);
+					break;
+				}
+		}
+		print_hexrays_slice(slice, slice_license);
+	}
+	return result == ELicenseState_Ok || result == ELicenseState_Corrupted ? 0 : 2;
 }
 
 int check_file_type(path filepath)
@@ -416,21 +537,31 @@ int check_file_type(path filepath)
 
 		file.read(magic.data(), magic_size);
 
-		if (magic.find("HEXRAYS_LICENSE") == 0)
+		// first offset of a magic in the header
+		auto find = [&](const char* text)
+		{
+			return find_bytes(reinterpret_cast<const uint8_t*>(magic.data()), magic.size(),
+				reinterpret_cast<const uint8_t*>(text), strlen(text));
+		};
+
+		if (find("HEXRAYS_LICENSE") == 0)
 			return EFileType_KEY;
 
-		if (magic.find("IDA0") == 0 ||
-			magic.find("IDA1") == 0 || 
-			magic.find("IDA2") == 0)
+		if (find("IDA0") == 0 ||
+			find("IDA1") == 0 || 
+			find("IDA2") == 0)
 			return EFileType_IDB;
 
-		if (magic.find("MZ") == 0)
+		if (find("MZ") == 0)
 			return EFileType_PE;
 
-		if (magic.find("ELF") == 1)
+		if (find("ELF") == 1)
 			return EFileType_ELF;
 
-		if (magic.find("\xCF\xFA\xED\xFE") == 0)
+		if (find("\xCF\xFA\xED\xFE") == 0)
+			return EFileType_DYLIB;
+
+		if (is_fat_header(reinterpret_cast<const uint8_t*>(magic.data()), magic.size()))
 			return EFileType_DYLIB;
 
 		if (size == 128 || size == 160)
@@ -439,6 +570,146 @@ int check_file_type(path filepath)
 	return EFileType_Unknown;
 }
 
+// Signatures to validate scanned moduli: keys give theirs, other files are split in blocks
+bool load_samples(const vector<string>& files, vector<uint8_t>& samples)
+{
+	for (const auto& file : files)
+	{
+		path sample(file_path(file));
+		if (check_file_type(sample) == EFileType_KEY)
+		{
+			key_t key;
+			if (!parse_key(sample, key)) return false;
+
+			samples.insert(samples.end(), cbegin(key.signature), cend(key.signature));
+			continue;
+		}
+
+		mapped_file data;
+		if (!data.open(sample)) return false;
+		size_t size = data.size() - data.size() % sizeof(signature_t);
+		samples.insert(samples.end(), data.data(), data.data() + size);
+	}
+	return true;
+}
+
+// Search an IDA binary for moduli close to the official one
+int scan_binary_moduli(path bin_file, path registry_file, const vector<string>& sample_files)
+{
+	cout << "Binary:" << '\t' << '\t' << bin_file << endl;
+
+	mapped_file bin;
+	if (!bin.open(bin_file))
+	{
+		cout << "Access error to file: " << bin_file << endl;
+		return 2;
+	}
+
+	vector<uint8_t> samples;
+	if (!load_samples(sample_files, samples))
+	{
+		cout << "Error: can't read samples" << endl;
+		return 2;
+	}
+
+	vector<modulus_candidate_t> candidates;
+	scan_moduli(bin.data(), bin.size(), ida_rsa_mod, candidates);
+	size_t count = samples.size() / sizeof(signature_t);
+	validate_candidates(candidates, reinterpret_cast<const signature_t*>(samples.data()), count);
+
+	// known moduli are written again, new ones only once validated
+	vector<registry_entry_t> entries;
+	shared_ptr<const registry_view_t> registry = g_registry.view();
+	if (registry)
+		entries.assign(registry->entries, registry->entries + registry->count);
+	else
+		entries = get_builtin_moduli();
+	size_t known = entries.size();
+
+	cout << "Samples:" << '\t' << count << endl
+		<< "Candidates:" << '\t' << candidates.size() << endl;
+
+	for (const auto& candidate : candidates)
+	{
+		bool is_known = false;
+		for (size_t i = 0; i < known; ++i)
+			if (!memcmp(entries[i].modulus, candidate.modulus, sizeof(signature_t)))
+			{
+				is_known = true;
+				break;
+			}
+
+		cout << endl << "Offset:" << '\t' << '\t' << "0x" << get_hex(static_cast<uint64_t>(candidate.offset)) << endl
+			<< "Distance:" << '\t' << candidate.distance << endl
+			<< "Suffix:" << '\t' << '\t' << candidate.suffix << endl
+			<< "Known:" << '\t' << '\t' << is_known << endl
+			<< "Validated:" << '\t' << candidate.validated << endl;
+
+		if (is_known || !candidate.validated) continue;
+
+		entries.emplace_back();
+		make_registry_entry(entries.back(), candidate.modulus,
+			"scan_" + get_hex(static_cast<uint64_t>(candidate.offset)));
+	}
+
+	if (!registry_file.empty())
+	{
+		cout << endl << "Save registry with " << entries.size() - known << " new moduli to: " << registry_file << endl;
+		if (!write_registry(registry_file, entries.data(), entries.size()))
+		{
+			cout << "Error: access fail" << endl;
+			return 2;
+		}
+		cout << "Registry saved" << endl;
+
+		// the loaded registry was rewritten, decrypt with the new moduli from now on
+		error_code error;
+		if (registry && equivalent(registry->filepath, registry_file, error) && !g_registry.reload())
+			cout << "Error: can't reload registry" << endl;
+	}
+	return 0;
+}
+
+// Every license marker and known modulus in the input, in one pass
+int list_markers(path in_file)
+{
+	cout << "File:" << '\t' << '\t' << in_file << endl << endl;
+
+	marker_set markers;
+	add_license_markers(markers);
+
+	vector<registry_entry_t> entries;
+	shared_ptr<const registry_view_t> registry = g_registry.view();
+	if (registry)
+		entries.assign(registry->entries, registry->entries + registry->count);
+	else
+		entries = get_builtin_moduli();
+	for (const auto& entry : entries)
+		markers.add(EMarker_Modulus, get_string(entry.name, IDA_REGISTRY_NAME_SIZE), entry.modulus, sizeof(signature_t));
+	if (!markers.build())
+	{
+		cout << "Too many markers: " << markers.size() << endl;
+		return 2;
+	}
+
+	ifstream file(in_file, ios::binary);
+	if (!file.is_open())
+	{
+		cout << "Access error to file: " << in_file << endl;
+		return 2;
+	}
+	file.close();
+
+	size_t count = scan_markers(in_file, markers, [&](const marker_hit_t& hit)
+	{
+		cout << "0x" << get_hex(hit.offset) << '\t' << markers[hit.marker].name << endl;
+		return true;
+	});
+
+	cout << endl << "Markers:" << '\t' << count << endl;
+	return 0;
+}
+
 int check_key(path in_file, path out_file = "")
 {
 	if (!exists(in_file))
@@ -451,7 +722,7 @@ int check_key(path in_file, path out_file = "")
 	switch (check_file_type(in_file))
 	{
 	case EFileType_KEY:
-		result = check_key_file(in_file, out_file);
+		result = g_key_bundle ? check_key_bundle(in_file, out_file) : check_key_file(in_file, out_file);
 		break;
 	case EFileType_IDB:
 		result = check_idb_user(in_file, out_file);
@@ -481,10 +752,28 @@ int main(int argc, char* argv[])
 	string file_input;
 	string file_output;
 	string file_type;
+	string rsa_trial;
+	string file_stats;
+	string file_registry;
+	string file_export;
+	string file_cache;
+	string file_scan;
+	string time_zone;
+	vector<string> sample_files;
 
 	options.add_options()
 		("i,input", "input file", cxxopts::value<std::string>(file_input)->default_value("ida.key"))
 		("o,output", "output filename (optional)", cxxopts::value<std::string>(file_output))
+		("t,trial", "rsa moduli trial: sequential, interleaved", cxxopts::value<std::string>(rsa_trial)->default_value("interleaved"))
+		("s,stats", "rsa moduli hit stats file, tried first by hits (optional)", cxxopts::value<std::string>(file_stats))
+		("r,registry", "known rsa moduli registry file (optional)", cxxopts::value<std::string>(file_registry))
+		("b,bundle", "the input key file holds several keys")
+		("z,timezone", "dates in: local, utc or a fixed offset like +03:00", cxxopts::value<std::string>(time_zone)->default_value("local"))
+		("c,cache", "decrypted signatures cache file (optional)", cxxopts::value<std::string>(file_cache))
+		("export-registry", "write the built-in rsa moduli to a registry file", cxxopts::value<std::string>(file_export))
+		("scan-moduli", "search the input binary for patched rsa moduli, write them to a registry file", cxxopts::value<std::string>(file_scan))
+		("samples", "signatures or keys validating the scanned moduli", cxxopts::value<std::vector<std::string>>(sample_files))
+		("markers", "list every license marker and known rsa modulus in the input with its offset")
 		("help", "print help");
 
 	cxxopts::ParseResult result;
@@ -504,11 +793,83 @@ int main(int argc, char* argv[])
 		return 1;
 	}
 	
+	if (rsa_trial == "sequential") g_rsa_trial = ERsaTrial_Sequential;
+	else if (rsa_trial == "interleaved") g_rsa_trial = ERsaTrial_Interleaved;
+	else
+	{
+		cout << options.help() << std::endl;
+		return 1;
+	}
+
+	g_key_bundle = result.count("bundle") != 0;
+
+	time_zone_t zone;
+	if (!parse_time_zone(time_zone, zone))
+	{
+		cout << options.help() << std::endl;
+		return 1;
+	}
+	set_time_zone(zone);
+
 	path input(file_path(file_input));
 	path output;
 
 	if (result.count("output")) output = file_path(result["output"].as<std::string>());
 
-	return check_key(input, output);
+	if (result.count("export-registry"))
+	{
+		path registry(file_path(file_export));
+		vector<registry_entry_t> entries = get_builtin_moduli();
+
+		cout << "Save registry to: " << registry << endl;
+		if (!write_registry(registry, entries.data(), entries.size()))
+		{
+			cout << "Error: access fail" << endl;
+			return 2;
+		}
+		cout << "Registry saved" << endl;
+		return 0;
+	}
+
+	if (result.count("registry"))
+	{
+		path registry(file_path(file_registry));
+		if (!g_registry.load(registry))
+		{
+			cout << "Invalid registry: " << registry << endl;
+			return 2;
+		}
+	}
+
+	if (result.count("cache"))
+	{
+		path cache(file_path(file_cache));
+		if (!g_cache.open(cache))
+			cout << "Error: can't open cache " << cache << endl;
+	}
+
+	if (result.count("scan-moduli"))
+		return scan_binary_moduli(input, file_path(file_scan), sample_files);
+
+	if (result.count("markers"))
+		return list_markers(input);
+
+	path stats;
+	if (result.count("stats"))
+	{
+		stats = file_path(file_stats);
+		get_verifier()->load_stats(stats);
+	}
+
+	int code = check_key(input, output);
+
+	// signatures that pushed older ones out of the cache
+	if (g_cache.is_open() && g_cache.full())
+		cout << endl << "Cache full:" << '\t' << g_cache.full() << endl;
+
+	if (!stats.empty() && !get_verifier()->save_stats(stats))
+		cout << "Error: can't save stats to " << stats << endl;
+
+	return code;
 }
 
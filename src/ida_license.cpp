@@ -5,6 +5,8 @@
 */
 
 #include "ida_license.hpp"
+#include "ida_rsa_mont.hpp"
+#include "ida_rsa_builtin.hpp"
 #include "bigint.hpp"
 
 namespace ida
@@ -31,16 +33,17 @@ namespace ida
 
 		if (sign[0] == 0) return false;
 
+		// built-in modulus, constants computed at compile time
+		if (!customModulus)
+			return mont_decrypt(k_mont_official, ida_rsa_pub, sign, license);
+
 		BI_CTX* BI;
 		bigint* pub, * mod, * msg, * emsg;
 
 		signature_t modulus;
 		signature_t data;
 
-		if (customModulus)
-			memcpy(modulus, customModulus, sizeof(signature_t));
-		else
-			memcpy(modulus, ida_rsa_mod, sizeof(signature_t));
+		memcpy(modulus, customModulus, sizeof(signature_t));
 
 		memcpy(data, sign, sizeof(signature_t));
 
@@ -62,4 +65,24 @@ namespace ida
 
 		return !license.zero ? true : false;
 	}
+
+	size_t decrypt_signatures(const signature_t* signs, license_t* licenses, bool* results,
+		size_t count, const uint8_t* customModulus)
+	{
+		if (!customModulus)
+			return mont_decrypt_batch(k_mont_official, ida_rsa_pub, signs, licenses, results, count);
+
+		mont_modulus_t mod;
+		if (mont_init(mod, customModulus))
+			return mont_decrypt_batch(mod, ida_rsa_pub, signs, licenses, results, count);
+
+		size_t decrypted = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			bool ok = decrypt_signature(signs[i], licenses[i], customModulus);
+			if (results) results[i] = ok;
+			if (ok) ++decrypted;
+		}
+		return decrypted;
+	}
 }
\ No newline at end of file
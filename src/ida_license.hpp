@@ -60,7 +60,7 @@ namespace ida
 	#pragma pack(pop)
 
 	// reverse-engineered modulus
-	const uint8_t ida_rsa_mod[] = {
+	constexpr uint8_t ida_rsa_mod[] = {
 		0xED, 0xFD, 0x42, 0x5C, 0xF9, 0x78, 0x54, 0x6E, 0x89, 0x11, 0x22, 0x58, 0x84, 0x43, 0x6C, 0x57,
 		0x14, 0x05, 0x25, 0x65, 0x0B, 0xCF, 0x6E, 0xBF, 0xE8, 0x0E, 0xDB, 0xC5, 0xFB, 0x1D, 0xE6, 0x8F,
 		0x4C, 0x66, 0xC2, 0x9C, 0xB2, 0x2E, 0xB6, 0x68, 0x78, 0x8A, 0xFC, 0xB0, 0xAB, 0xBB, 0x71, 0x80,
@@ -73,8 +73,15 @@ namespace ida
 
 	const uint8_t ida_rsa_pub = 0x13;
 
+	void reverse_block(uint8_t* buffer, size_t size);
+
 	bool decrypt_signature(const signature_t& sign, license_t& license,
 		const uint8_t* customModulus = nullptr);
+
+	// blocks sharing one modulus, several at once where the cpu allows,
+	// results may be nullptr, returns the number of decrypted blocks
+	size_t decrypt_signatures(const signature_t* signs, license_t* licenses, bool* results,
+		size_t count, const uint8_t* customModulus = nullptr);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,249 @@
+/*
+* Memory mapped file, read-only or shared read-write
+*
+* RnD, 2021
+*/
+
+#include "ida_mapped_file.hpp"
+
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace ida
+{
+#ifdef WIN32
+	bool mapped_file::open(const path& filepath)
+	{
+		close();
+
+		HANDLE file = CreateFileW(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size))
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		m_size = static_cast<size_t>(size.QuadPart);
+		if (!m_size)
+		{
+			// nothing to map
+			CloseHandle(file);
+			m_open = true;
+			return true;
+		}
+
+		// the mapping keeps its own reference to the file
+		HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if (!mapping)
+		{
+			m_size = 0;
+			return false;
+		}
+
+		m_data = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!m_data)
+		{
+			CloseHandle(mapping);
+			m_size = 0;
+			return false;
+		}
+		m_handle = mapping;
+		m_open = true;
+		return true;
+	}
+
+	bool mapped_file::open_shared(const path& filepath, size_t size)
+	{
+		close();
+
+		HANDLE file = CreateFileW(filepath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+			nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+		m_file = reinterpret_cast<intptr_t>(file);
+
+		// another process may be growing it at the same time
+		LARGE_INTEGER current;
+		if (!lock() || !GetFileSizeEx(file, &current))
+		{
+			close();
+			return false;
+		}
+		m_size = static_cast<size_t>(current.QuadPart) < size ? size : static_cast<size_t>(current.QuadPart);
+
+		// the mapping grows the file with zeros
+		LARGE_INTEGER length;
+		length.QuadPart = static_cast<LONGLONG>(m_size);
+		HANDLE mapping = m_size ? CreateFileMappingW(file, nullptr, PAGE_READWRITE,
+			static_cast<DWORD>(length.HighPart), length.LowPart, nullptr) : nullptr;
+		unlock();
+		if (!mapping)
+		{
+			close();
+			return false;
+		}
+
+		m_data = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0));
+		m_handle = mapping;
+		if (!m_data)
+		{
+			close();
+			return false;
+		}
+		m_writable = true;
+		m_open = true;
+		return true;
+	}
+
+	bool mapped_file::lock()
+	{
+		if (m_file == -1) return false;
+
+		// a byte far past the end, locked ranges must not overlap the view
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = 0xffffffff;
+		overlapped.OffsetHigh = 0x7fffffff;
+		return LockFileEx(reinterpret_cast<HANDLE>(m_file), LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped) != FALSE;
+	}
+
+	void mapped_file::unlock()
+	{
+		if (m_file == -1) return;
+
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = 0xffffffff;
+		overlapped.OffsetHigh = 0x7fffffff;
+		UnlockFileEx(reinterpret_cast<HANDLE>(m_file), 0, 1, 0, &overlapped);
+	}
+
+	void mapped_file::close()
+	{
+		if (m_data) UnmapViewOfFile(m_data);
+		if (m_handle) CloseHandle(m_handle);
+		if (m_file != -1) CloseHandle(reinterpret_cast<HANDLE>(m_file));
+
+		m_data = nullptr;
+		m_size = 0;
+		m_handle = nullptr;
+		m_file = -1;
+		m_writable = false;
+		m_open = false;
+	}
+#else
+	bool mapped_file::open(const path& filepath)
+	{
+		close();
+
+		int fd = ::open(filepath.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+		{
+			::close(fd);
+			return false;
+		}
+
+		m_size = static_cast<size_t>(st.st_size);
+		if (!m_size)
+		{
+			// nothing to map
+			::close(fd);
+			m_open = true;
+			return true;
+		}
+
+		// the mapping stays valid after the descriptor is closed
+		void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (data == MAP_FAILED)
+		{
+			m_size = 0;
+			return false;
+		}
+		m_data = static_cast<uint8_t*>(data);
+		m_open = true;
+		return true;
+	}
+
+	bool mapped_file::open_shared(const path& filepath, size_t size)
+	{
+		close();
+
+		int fd = ::open(filepath.c_str(), O_RDWR | O_CREAT, 0644);
+		if (fd < 0) return false;
+		m_file = fd;
+
+		// another process may be growing it at the same time
+		struct stat st;
+		if (!lock() || fstat(fd, &st) != 0)
+		{
+			close();
+			return false;
+		}
+
+		bool grown = true;
+		m_size = static_cast<size_t>(st.st_size);
+		if (m_size < size)
+		{
+			grown = ftruncate(fd, static_cast<off_t>(size)) == 0;
+			m_size = size;
+		}
+		unlock();
+
+		void* data = grown && m_size ? mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+		if (data == MAP_FAILED)
+		{
+			m_size = 0;
+			close();
+			return false;
+		}
+		m_data = static_cast<uint8_t*>(data);
+		m_writable = true;
+		m_open = true;
+		return true;
+	}
+
+	bool mapped_file::lock()
+	{
+		if (m_file == -1) return false;
+
+		int result;
+		do
+			result = flock(static_cast<int>(m_file), LOCK_EX);
+		while (result != 0 && errno == EINTR);
+		return result == 0;
+	}
+
+	void mapped_file::unlock()
+	{
+		if (m_file != -1)
+			flock(static_cast<int>(m_file), LOCK_UN);
+	}
+
+	void mapped_file::close()
+	{
+		if (m_data) munmap(m_data, m_size);
+		if (m_file != -1) ::close(static_cast<int>(m_file));
+
+		m_data = nullptr;
+		m_size = 0;
+		m_handle = nullptr;
+		m_file = -1;
+		m_writable = false;
+		m_open = false;
+	}
+#endif
+}
@@ -0,0 +1,70 @@
+/*
+* Memory mapped file header, read-only or shared read-write
+*
+* RnD, 2021
+*/
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _IDA_MAPPED_FILE_HPP_
+#define _IDA_MAPPED_FILE_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <utility>
+
+namespace ida
+{
+	using namespace std;
+	using namespace filesystem;
+
+	// whole file mapped read-only or shared read-write, unmapped on close or destruction
+	class mapped_file
+	{
+	public:
+		mapped_file() : m_data(nullptr), m_size(0), m_handle(nullptr), m_file(-1), m_writable(false), m_open(false) {}
+		~mapped_file() { close(); }
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		// empty files open with a null view
+		bool open(const path& filepath);
+		// writable view shared with other processes, the file is created
+		// and grown with zeros to at least size bytes
+		bool open_shared(const path& filepath, size_t size);
+		void close();
+
+		// exclusive advisory lock between processes, shared views only
+		bool lock();
+		void unlock();
+
+		void swap(mapped_file& other)
+		{
+			std::swap(m_data, other.m_data);
+			std::swap(m_size, other.m_size);
+			std::swap(m_handle, other.m_handle);
+			std::swap(m_file, other.m_file);
+			std::swap(m_writable, other.m_writable);
+			std::swap(m_open, other.m_open);
+		}
+
+		bool is_open() const { return m_open; }
+		const uint8_t* data() const { return m_data; }
+		uint8_t* writable_data() const { return m_writable ? m_data : nullptr; }
+		size_t size() const { return m_size; }
+
+	private:
+		uint8_t* m_data;
+		size_t m_size;
+		void* m_handle; // file mapping object on windows
+		intptr_t m_file; // descriptor or handle kept by shared views for locking
+		bool m_writable;
+		bool m_open; // empty files are open without a view
+	};
+}
+
+#endif // _IDA_MAPPED_FILE_HPP_
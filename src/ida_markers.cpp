@@ -0,0 +1,253 @@
+/*
+* License marker inventory
+*
+* RnD, 2021
+*/
+
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+#include "ida_markers.hpp"
+#include "ida_rays_license.hpp"
+
+namespace ida
+{
+	const uint32_t k_none = 0xffffffff;
+
+	void marker_set::add(EMarker type, const string& name, const uint8_t* pattern, size_t length)
+	{
+		if (!length) return;
+		m_markers.push_back({ type, name, vector<uint8_t>(pattern, pattern + length) });
+	}
+
+	bool marker_set::build()
+	{
+		m_delta.clear();
+		m_first.clear();
+		m_next.assign(m_markers.size(), k_none);
+		m_link.clear();
+		m_fail.clear();
+		m_edge.clear();
+		m_edges.clear();
+
+		// a state and the byte of its edge share an uint32_t, rows are state * 256
+		size_t bytes = 0;
+		for (const auto& marker : m_markers)
+			bytes += marker.pattern.size();
+		if (bytes >= IDA_MARKER_STATES_MAX) return false;
+
+		// trie, the edges of a state are (child << 8) | byte
+		vector<vector<uint32_t>> children(1);
+		vector<uint32_t> first(1, k_none);
+		vector<uint8_t> depth(1, 0);
+
+		auto child = [&](uint32_t state, uint8_t c)
+		{
+			for (uint32_t edge : children[state])
+				if ((edge & 0xff) == c) return edge >> 8;
+			return k_none;
+		};
+
+		for (uint32_t i = 0; i < m_markers.size(); ++i)
+		{
+			uint32_t state = 0;
+			for (uint8_t c : m_markers[i].pattern)
+			{
+				uint32_t next = child(state, c);
+				if (next == k_none)
+				{
+					next = static_cast<uint32_t>(first.size());
+					children[state].push_back((next << 8) | c);
+					children.emplace_back();
+					first.push_back(k_none);
+					depth.push_back(static_cast<uint8_t>(min<size_t>(depth[state] + 1, IDA_MARKER_DENSE_DEPTH)));
+				}
+				state = next;
+			}
+
+			// same patterns are chained in the order they were added
+			uint32_t* tail = &first[state];
+			while (*tail != k_none) tail = &m_next[*tail];
+			*tail = i;
+		}
+
+		// breadth first, a state fails to the longest proper suffix in the trie
+		size_t states = first.size();
+		vector<uint32_t> fail(states, 0), link(states, 0), queue(1, 0);
+		queue.reserve(states);
+
+		for (size_t head = 0; head < queue.size(); ++head)
+		{
+			uint32_t state = queue[head];
+			for (uint32_t edge : children[state])
+			{
+				uint32_t next = edge >> 8;
+				uint8_t c = static_cast<uint8_t>(edge);
+
+				uint32_t suffix = 0;
+				if (state)
+				{
+					uint32_t u = fail[state];
+					while (u && child(u, c) == k_none) u = fail[u];
+					suffix = child(u, c) != k_none ? child(u, c) : 0;
+				}
+				fail[next] = suffix;
+				link[next] = first[suffix] != k_none ? suffix : link[suffix];
+				queue.push_back(next);
+			}
+		}
+
+		// shallow states get a dense row, deeper ones only their trie edges,
+		// numbered as dense without hits, dense with hits, deep,
+		// so the scan tells them apart by number
+		vector<uint32_t> order(states);
+		uint32_t count = 0;
+		for (int group = 0; group < 3; ++group)
+		{
+			for (uint32_t state : queue)
+			{
+				bool dense = depth[state] < IDA_MARKER_DENSE_DEPTH;
+				bool hit = first[state] != k_none || link[state];
+				if (group == (!dense ? 2 : hit ? 1 : 0))
+					order[state] = count++;
+			}
+			if (group == 0) m_slow_row = static_cast<size_t>(count) * 256;
+			if (group == 1) m_deep = count;
+		}
+
+		m_first.resize(states);
+		m_link.resize(states);
+		for (size_t i = 0; i < states; ++i)
+		{
+			m_first[order[i]] = first[i];
+			m_link[order[i]] = order[link[i]];
+		}
+
+		// rows hold the row of the next state, a miss takes the row of the suffix,
+		// which is shallower and so filled first
+		m_delta.assign(static_cast<size_t>(m_deep) * 256, 0);
+		for (uint32_t state : queue)
+		{
+			if (order[state] >= m_deep) continue;
+
+			uint32_t* row = m_delta.data() + static_cast<size_t>(order[state]) * 256;
+			if (state)
+				memcpy(row, m_delta.data() + static_cast<size_t>(order[fail[state]]) * 256, 256 * sizeof(uint32_t));
+			for (uint32_t edge : children[state])
+				row[edge & 0xff] = order[edge >> 8] * 256;
+		}
+
+		// deep states in their numbering order
+		vector<uint32_t> deep(states - m_deep);
+		for (size_t i = 0; i < states; ++i)
+			if (order[i] >= m_deep)
+				deep[order[i] - m_deep] = static_cast<uint32_t>(i);
+
+		m_fail.resize(deep.size());
+		m_edge.assign(1, 0);
+		for (size_t i = 0; i < deep.size(); ++i)
+		{
+			m_fail[i] = order[fail[deep[i]]];
+			for (uint32_t edge : children[deep[i]])
+				m_edges.push_back((order[edge >> 8] << 8) | (edge & 0xff));
+			m_edge.push_back(static_cast<uint32_t>(m_edges.size()));
+		}
+		return true;
+	}
+
+	uint32_t marker_set::step(uint32_t state, uint8_t c) const
+	{
+		// a deep state has its trie edges only, a miss follows the suffix links to a dense state
+		while (state >= m_deep)
+		{
+			size_t index = state - m_deep;
+			for (uint32_t e = m_edge[index]; e < m_edge[index + 1]; ++e)
+				if ((m_edges[e] & 0xff) == c)
+					return m_edges[e] >> 8;
+			state = m_fail[index];
+		}
+		return m_delta[static_cast<size_t>(state) * 256 + c] / 256;
+	}
+
+	bool marker_set::report(uint32_t state, uint64_t end, const marker_callback_t& callback) const
+	{
+		for (; state; state = m_link[state])
+			for (uint32_t i = m_first[state]; i != k_none; i = m_next[i])
+				if (!callback({ i, end - m_markers[i].pattern.size() }))
+					return false;
+		return true;
+	}
+
+	bool marker_set::scan(const uint8_t* data, size_t size, uint64_t offset, uint32_t& state,
+		const marker_callback_t& callback) const
+	{
+		if (m_delta.empty()) return true;
+
+		const uint32_t* delta = m_delta.data();
+		const size_t deep_row = static_cast<size_t>(m_deep) * 256;
+		size_t row = static_cast<size_t>(state) * 256;
+		size_t i = 0;
+
+		while (i < size)
+		{
+			if (row < m_slow_row)
+			{
+				// dense states without hits, one load per byte
+				do
+					row = delta[row + data[i++]];
+				while (row < m_slow_row && i < size);
+				if (row < m_slow_row) break;
+			}
+			else if (row < deep_row)
+				row = delta[row + data[i++]];
+			else
+				row = static_cast<size_t>(step(static_cast<uint32_t>(row / 256), data[i++])) * 256;
+
+			if (row >= m_slow_row && !report(static_cast<uint32_t>(row / 256), offset + i, callback))
+			{
+				state = static_cast<uint32_t>(row / 256);
+				return false;
+			}
+		}
+		state = static_cast<uint32_t>(row / 256);
+		return true;
+	}
+
+	void add_license_markers(marker_set& markers)
+	{
+		const uint8_t key_text[] = { 'H', 'E', 'X', 'R', 'A', 'Y', 'S', '_', 'L', 'I', 'C', 'E', 'N', 'S', 'E' };
+
+		markers.add(EMarker_RaysVersion, "HEXRAYS_VERSION", ida_rays_version_text, sizeof(ida_rays_version_text));
+		markers.add(EMarker_RaysSign, "rays_license", ida_rays_license_sign, sizeof(ida_rays_license_sign));
+		markers.add(EMarker_KeyText, "HEXRAYS_LICENSE", key_text, sizeof(key_text));
+	}
+
+	size_t scan_markers(const path& filepath, const marker_set& markers, const marker_callback_t& callback,
+		size_t window)
+	{
+		ifstream file(filepath, ios::binary);
+		if (!file.is_open()) return 0;
+
+		// partial matches carry over in the state, windows need no overlap
+		vector<uint8_t> buffer(window ? window : IDA_MARKER_WINDOW);
+		uint64_t offset = 0;
+		uint32_t state = 0;
+		size_t count = 0;
+
+		auto counted = [&](const marker_hit_t& hit)
+		{
+			++count;
+			return callback(hit);
+		};
+
+		while (file)
+		{
+			file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+			size_t used = static_cast<size_t>(file.gcount());
+			if (!markers.scan(buffer.data(), used, offset, state, counted)) break;
+			offset += used;
+		}
+		return count;
+	}
+}
@@ -0,0 +1,100 @@
+/*
+* License marker inventory header
+*
+* RnD, 2021
+*/
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _IDA_MARKERS_HPP_
+#define _IDA_MARKERS_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+#include <filesystem>
+
+#define IDA_MARKER_WINDOW	(1 << 20)
+#define IDA_MARKER_STATES_MAX	(1 << 24)	// rows are state * 256 in an uint32_t
+
+#ifndef IDA_MARKER_DENSE_DEPTH
+#define IDA_MARKER_DENSE_DEPTH	4	// states this shallow get a full row
+#endif
+
+namespace ida
+{
+	using namespace std;
+	using namespace filesystem;
+
+	enum EMarker
+	{
+		EMarker_RaysVersion = 0,	// HEXRAYS_VERSION of a decompiler plugin
+		EMarker_RaysSign,			// rays_license_t flags
+		EMarker_KeyText,			// HEXRAYS_LICENSE of an embedded key
+		EMarker_Modulus,			// rsa modulus
+	};
+
+	typedef struct marker_t
+	{
+		EMarker type;
+		string name;
+		vector<uint8_t> pattern;
+	} marker_t;
+
+	typedef struct marker_hit_t
+	{
+		uint32_t marker; // index in the set
+		uint64_t offset; // of the first byte
+	} marker_hit_t;
+
+	// false stops the scan
+	typedef function<bool(const marker_hit_t& hit)> marker_callback_t;
+
+	// aho-corasick automaton of every pattern, one pass reports all of them,
+	// the states of the first pattern bytes have a 1 KB row, deeper ones their trie edges only
+	class marker_set
+	{
+	public:
+		// empty patterns are ignored, build once all are added,
+		// false if the patterns hold 2^24 bytes or more
+		void add(EMarker type, const string& name, const uint8_t* pattern, size_t length);
+		bool build();
+
+		size_t size() const { return m_markers.size(); }
+		const marker_t& operator[](size_t index) const { return m_markers[index]; }
+
+		// hits in order of their last byte, the longest first at the same byte,
+		// state carries partial matches from the previous call, 0 starts over,
+		// offset is the file offset of data[0], false if the callback stopped
+		bool scan(const uint8_t* data, size_t size, uint64_t offset, uint32_t& state,
+			const marker_callback_t& callback) const;
+
+	private:
+		bool report(uint32_t state, uint64_t end, const marker_callback_t& callback) const;
+		uint32_t step(uint32_t state, uint8_t c) const;
+
+		vector<marker_t> m_markers;
+		vector<uint32_t> m_delta;	// 256 per dense state, the row of the next state
+		vector<uint32_t> m_first;	// first marker ending in a state
+		vector<uint32_t> m_next;	// next marker with the same pattern end
+		vector<uint32_t> m_link;	// longest proper suffix state with hits, 0 if none
+		vector<uint32_t> m_fail;	// per deep state, longest proper suffix state
+		vector<uint32_t> m_edge;	// per deep state, first of its edges, one more at the end
+		vector<uint32_t> m_edges;	// (next state << 8) | byte
+		size_t m_slow_row = 0;		// rows from here belong to states with hits or deep ones
+		uint32_t m_deep = 0;		// states from here are deep
+	};
+
+	// the rays version text and license sign, the key text
+	void add_license_markers(marker_set& markers);
+
+	// every hit in the file, read through a window of fixed size,
+	// returns the number of reported hits
+	size_t scan_markers(const path& filepath, const marker_set& markers, const marker_callback_t& callback,
+		size_t window = IDA_MARKER_WINDOW);
+}
+
+#endif // _IDA_MARKERS_HPP_
@@ -0,0 +1,303 @@
+/*
+* Executable module layout
+*
+* RnD, 2021
+*/
+
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+#include "ida_module.hpp"
+
+namespace ida
+{
+	// pe
+	const uint32_t k_pe_code = 0x00000020;				// IMAGE_SCN_CNT_CODE
+	const uint32_t k_pe_data = 0x00000040;				// IMAGE_SCN_CNT_INITIALIZED_DATA
+	const uint32_t k_pe_execute = 0x20000000;			// IMAGE_SCN_MEM_EXECUTE
+
+	// elf
+	const uint32_t k_elf_progbits = 1;					// SHT_PROGBITS
+	const uint64_t k_elf_alloc = 0x2;					// SHF_ALLOC
+	const uint64_t k_elf_exec = 0x4;					// SHF_EXECINSTR
+	const uint32_t k_elf_load = 1;						// PT_LOAD
+	const uint32_t k_elf_x = 0x1;						// PF_X
+
+	// mach-o
+	const uint32_t k_macho_magic64 = 0xfeedfacf;
+	const uint32_t k_fat_magic = 0xcafebabe;			// big-endian, as the whole fat header
+	const uint32_t k_fat_magic64 = 0xcafebabf;
+	const uint32_t k_fat_max = 32;						// java classes share the magic, their version is 45 or more
+	const uint32_t k_macho_segment64 = 0x19;			// LC_SEGMENT_64
+	const uint32_t k_macho_code = 0x80000400;			// S_ATTR_PURE_INSTRUCTIONS | S_ATTR_SOME_INSTRUCTIONS
+
+	// module bytes in the file, a whole file or a slice of a universal one
+	typedef struct image_t
+	{
+		istream& file;
+		uint64_t base;
+		uint64_t size;
+	} image_t;
+
+	// the headers come from the file, every field is checked against the image size
+	static bool read_at(const image_t& image, uint64_t offset, void* data, size_t length)
+	{
+		if (offset > image.size || length > image.size - offset) return false;
+
+		image.file.clear();
+		image.file.seekg(static_cast<streamoff>(image.base + offset), ios::beg);
+		image.file.read(reinterpret_cast<char*>(data), length);
+		return static_cast<size_t>(image.file.gcount()) == length;
+	}
+
+	// a header table, its size is checked against the image before allocating
+	static bool read_table(const image_t& image, uint64_t offset, uint64_t length, vector<uint8_t>& table)
+	{
+		if (offset > image.size || length > image.size - offset) return false;
+
+		table.resize(static_cast<size_t>(length));
+		return read_at(image, offset, table.data(), table.size());
+	}
+
+	// little-endian field
+	template<typename T>
+	static inline T get(const uint8_t* data, size_t offset)
+	{
+		T value;
+		memcpy(&value, data + offset, sizeof(T));
+		return value;
+	}
+
+	static inline uint32_t get_be32(const uint8_t* data, size_t offset)
+	{
+		return (static_cast<uint32_t>(data[offset]) << 24) | (static_cast<uint32_t>(data[offset + 1]) << 16) |
+			(static_cast<uint32_t>(data[offset + 2]) << 8) | data[offset + 3];
+	}
+
+	static inline uint64_t get_be64(const uint8_t* data, size_t offset)
+	{
+		return (static_cast<uint64_t>(get_be32(data, offset)) << 32) | get_be32(data, offset + 4);
+	}
+
+	// image offsets to file offsets
+	static void add_range(vector<file_range_t>& ranges, const image_t& image, uint64_t offset, uint64_t length)
+	{
+		if (offset >= image.size || !length) return;
+		ranges.push_back({ image.base + offset, min(length, image.size - offset) });
+	}
+
+	static bool get_pe_ranges(const image_t& image, vector<file_range_t>& ranges)
+	{
+		uint8_t dos[64];
+		if (!read_at(image, 0, dos, sizeof(dos)) || get<uint16_t>(dos, 0) != 0x5a4d) return false;
+
+		// signature and file header
+		uint32_t lfanew = get<uint32_t>(dos, 0x3c);
+		uint8_t nt[24];
+		if (!read_at(image, lfanew, nt, sizeof(nt)) || get<uint32_t>(nt, 0) != 0x00004550) return false;
+
+		uint16_t count = get<uint16_t>(nt, 6);
+		uint64_t table = static_cast<uint64_t>(lfanew) + sizeof(nt) + get<uint16_t>(nt, 20);
+
+		vector<uint8_t> sections;
+		if (!read_table(image, table, static_cast<uint64_t>(count) * 40, sections)) return false;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const uint8_t* section = sections.data() + i * 40;
+			uint32_t flags = get<uint32_t>(section, 36);
+			if (!(flags & k_pe_data) || (flags & (k_pe_code | k_pe_execute))) continue;
+
+			// raw data, .bss has none
+			add_range(ranges, image, get<uint32_t>(section, 20), get<uint32_t>(section, 16));
+		}
+		return true;
+	}
+
+	static bool get_elf_ranges(const image_t& image, vector<file_range_t>& ranges)
+	{
+		uint8_t header[64];
+		if (!read_at(image, 0, header, 52) || memcmp(header, "\x7f" "ELF", 4)) return false;
+
+		// little-endian modules only
+		bool is64 = header[4] == 2;
+		if ((header[4] != 1 && !is64) || header[5] != 1) return false;
+		if (is64 && !read_at(image, 0, header, sizeof(header))) return false;
+
+		uint64_t shoff = is64 ? get<uint64_t>(header, 0x28) : get<uint32_t>(header, 0x20);
+		uint16_t shentsize = get<uint16_t>(header, is64 ? 0x3a : 0x2e);
+		uint16_t shnum = get<uint16_t>(header, is64 ? 0x3c : 0x30);
+		uint64_t phoff = is64 ? get<uint64_t>(header, 0x20) : get<uint32_t>(header, 0x1c);
+		uint16_t phentsize = get<uint16_t>(header, is64 ? 0x36 : 0x2a);
+		uint16_t phnum = get<uint16_t>(header, is64 ? 0x38 : 0x2c);
+
+		// sections when there are any
+		if (shoff && shnum && shentsize >= (is64 ? 0x28 : 0x18))
+		{
+			vector<uint8_t> table;
+			if (!read_table(image, shoff, static_cast<uint64_t>(shnum) * shentsize, table)) return false;
+
+			for (size_t i = 0; i < shnum; ++i)
+			{
+				const uint8_t* section = table.data() + i * shentsize;
+				uint32_t type = get<uint32_t>(section, 4);
+				uint64_t flags = is64 ? get<uint64_t>(section, 8) : get<uint32_t>(section, 8);
+				if (type != k_elf_progbits || !(flags & k_elf_alloc) || (flags & k_elf_exec)) continue;
+
+				add_range(ranges, image,
+					is64 ? get<uint64_t>(section, 0x18) : get<uint32_t>(section, 0x10),
+					is64 ? get<uint64_t>(section, 0x20) : get<uint32_t>(section, 0x14));
+			}
+			return true;
+		}
+
+		// stripped of them, the loadable segments that do not execute
+		if (!phoff || !phnum || phentsize < (is64 ? 0x38 : 0x20)) return false;
+
+		vector<uint8_t> table;
+		if (!read_table(image, phoff, static_cast<uint64_t>(phnum) * phentsize, table)) return false;
+
+		for (size_t i = 0; i < phnum; ++i)
+		{
+			const uint8_t* segment = table.data() + i * phentsize;
+			uint32_t flags = get<uint32_t>(segment, is64 ? 4 : 0x18);
+			if (get<uint32_t>(segment, 0) != k_elf_load || (flags & k_elf_x)) continue;
+
+			add_range(ranges, image,
+				is64 ? get<uint64_t>(segment, 8) : get<uint32_t>(segment, 4),
+				is64 ? get<uint64_t>(segment, 0x20) : get<uint32_t>(segment, 0x10));
+		}
+		return true;
+	}
+
+	static bool get_macho_ranges(const image_t& image, vector<file_range_t>& ranges)
+	{
+		uint8_t header[32];
+		if (!read_at(image, 0, header, sizeof(header)) || get<uint32_t>(header, 0) != k_macho_magic64)
+			return false;
+
+		uint32_t ncmds = get<uint32_t>(header, 16);
+		vector<uint8_t> commands;
+		if (!read_table(image, sizeof(header), get<uint32_t>(header, 20), commands)) return false;
+
+		size_t pos = 0;
+		for (uint32_t i = 0; i < ncmds; ++i)
+		{
+			if (commands.size() - pos < 8) return false;
+			uint32_t cmd = get<uint32_t>(commands.data(), pos);
+			uint32_t cmdsize = get<uint32_t>(commands.data(), pos + 4);
+			if (cmdsize < 8 || cmdsize > commands.size() - pos) return false;
+
+			if (cmd == k_macho_segment64 && cmdsize >= 72)
+			{
+				const uint8_t* segment = commands.data() + pos;
+				uint32_t nsects = get<uint32_t>(segment, 64);
+				if (nsects > (cmdsize - 72) / 80) return false;
+
+				for (uint32_t j = 0; j < nsects; ++j)
+				{
+					const uint8_t* section = segment + 72 + j * 80;
+					uint32_t flags = get<uint32_t>(section, 64);
+					uint8_t type = static_cast<uint8_t>(flags);
+
+					// zero fill sections have no file bytes
+					if ((flags & k_macho_code) || type == 0x01 || type == 0x0c || type == 0x12) continue;
+					add_range(ranges, image, get<uint32_t>(section, 48), get<uint64_t>(section, 40));
+				}
+			}
+			pos += cmdsize;
+		}
+		return true;
+	}
+
+	bool get_data_ranges(istream& file, uint64_t base, uint64_t size, vector<file_range_t>& ranges)
+	{
+		ranges.clear();
+
+		const image_t image = { file, base, size };
+		vector<file_range_t> found;
+		if (!get_pe_ranges(image, found) &&
+			!get_elf_ranges(image, found) &&
+			!get_macho_ranges(image, found))
+			return false;
+
+		// in file order, overlapping and adjacent ranges scan as one,
+		// so a marker across two sections is still found
+		sort(found.begin(), found.end(),
+			[](const file_range_t& a, const file_range_t& b) { return a.offset < b.offset; });
+		for (const auto& range : found)
+		{
+			if (!ranges.empty() && range.offset <= ranges.back().offset + ranges.back().size)
+			{
+				auto& last = ranges.back();
+				last.size = max(last.size, range.offset + range.size - last.offset);
+			}
+			else
+				ranges.push_back(range);
+		}
+
+		file.clear();
+		return !ranges.empty();
+	}
+
+	bool is_fat_header(const uint8_t* data, size_t size)
+	{
+		if (size < 8) return false;
+
+		uint32_t magic = get_be32(data, 0), count = get_be32(data, 4);
+		return (magic == k_fat_magic || magic == k_fat_magic64) && count && count < k_fat_max;
+	}
+
+	bool get_fat_slices(istream& file, uint64_t size, vector<module_slice_t>& slices)
+	{
+		slices.clear();
+
+		const image_t image = { file, 0, size };
+		uint8_t header[8];
+		if (!read_at(image, 0, header, sizeof(header)) || !is_fat_header(header, sizeof(header))) return false;
+
+		// fat_arch or fat_arch_64 entries
+		bool is64 = get_be32(header, 0) == k_fat_magic64;
+		size_t entry = is64 ? 32 : 20;
+		vector<uint8_t> table;
+		if (!read_table(image, sizeof(header), get_be32(header, 4) * entry, table)) return false;
+
+		for (size_t i = 0; i < table.size(); i += entry)
+		{
+			const uint8_t* arch = table.data() + i;
+			module_slice_t slice;
+			slice.cputype = get_be32(arch, 0);
+			slice.cpusubtype = get_be32(arch, 4);
+			slice.offset = is64 ? get_be64(arch, 8) : get_be32(arch, 8);
+			slice.size = is64 ? get_be64(arch, 16) : get_be32(arch, 12);
+
+			// slices past the end are skipped, the others are still scanned
+			if (!slice.size || slice.offset > size || slice.size > size - slice.offset) continue;
+			slices.push_back(slice);
+		}
+
+		file.clear();
+		return !slices.empty();
+	}
+
+	string get_cpu_name(uint32_t cputype, uint32_t cpusubtype)
+	{
+		// the high byte of the subtype holds capability bits
+		cpusubtype &= 0x00ffffff;
+		if (cputype == 0x01000007 && cpusubtype == 8) return "x86_64h";
+		if (cputype == 0x0100000c && cpusubtype == 2) return "arm64e";
+
+		switch (cputype)
+		{
+		case 0x00000007: return "i386";
+		case 0x01000007: return "x86_64";
+		case 0x0000000c: return "arm";
+		case 0x0100000c: return "arm64";
+		case 0x0200000c: return "arm64_32";
+		case 0x00000012: return "ppc";
+		case 0x01000012: return "ppc64";
+		}
+		return "cpu_" + to_string(cputype);
+	}
+}
@@ -0,0 +1,51 @@
+/*
+* Executable module layout header
+*
+* RnD, 2021
+*/
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _IDA_MODULE_HPP_
+#define _IDA_MODULE_HPP_
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace ida
+{
+	using namespace std;
+
+	typedef struct file_range_t
+	{
+		uint64_t offset;
+		uint64_t size;
+	} file_range_t;
+
+	// slice of a universal mach-o
+	typedef struct module_slice_t
+	{
+		uint32_t cputype;
+		uint32_t cpusubtype;
+		uint64_t offset;
+		uint64_t size;
+	} module_slice_t;
+
+	// file bytes of the initialized, not executable sections of a pe, elf or mach-o 64 module
+	// of size bytes at base in the file, sorted and merged,
+	// false if the headers do not parse or hold no such section
+	bool get_data_ranges(istream& file, uint64_t base, uint64_t size, vector<file_range_t>& ranges);
+
+	// universal mach-o magic and a plausible arch count, java classes have the same magic
+	bool is_fat_header(const uint8_t* data, size_t size);
+	// slices inside the file, false if it is not a universal mach-o or none is
+	bool get_fat_slices(istream& file, uint64_t size, vector<module_slice_t>& slices);
+	// "x86_64", "arm64", "arm64e", ...
+	string get_cpu_name(uint32_t cputype, uint32_t cpusubtype = 0);
+}
+
+#endif // _IDA_MODULE_HPP_
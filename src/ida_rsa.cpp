@@ -0,0 +1,352 @@
+/*
+* IDA Pro rsa signature verifier
+*
+* RnD, 2021
+*/
+
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <fstream>
+#include <cstdlib>
+
+#include "ida_rsa.hpp"
+#include "bigint.hpp"
+
+namespace ida
+{
+	struct rsa_context_t
+	{
+		BI_CTX* BI;
+		bigint* pub;
+
+		rsa_context_t(const uint8_t* modulus, uint32_t exponent)
+		{
+			signature_t data;
+
+			memcpy(data, modulus, sizeof(signature_t));
+			reverse_block(data, sizeof(signature_t));
+
+			// the modulus and the exponent stay in the context until destruction
+			BI = bi_initialize();
+			bi_set_mod(BI, bi_import(BI, data, IDA_RSA_BLOCK_SIZE), BIGINT_M_OFFSET);
+
+			pub = int_to_bi(BI, exponent);
+			bi_permanent(pub);
+		}
+
+		~rsa_context_t()
+		{
+			bi_depermanent(pub);
+			bi_free(BI, pub);
+
+			bi_free_mod(BI, BIGINT_M_OFFSET);
+			bi_terminate(BI);
+		}
+	};
+
+	rsa_modulus::rsa_modulus(const uint8_t* modulus, const string& name, uint32_t exponent)
+		: m_name(name), m_exponent(exponent), m_hits(0), m_checked(true)
+	{
+		memcpy(m_modulus, modulus, sizeof(signature_t));
+		m_is_mont = mont_init(m_mont, modulus);
+	}
+
+	rsa_modulus::rsa_modulus(const uint8_t* modulus, const mont_modulus_t& mont, const string& name,
+		uint32_t exponent)
+		: m_name(name), m_exponent(exponent), m_is_mont(true), m_mont(mont), m_hits(0), m_checked(false)
+	{
+		memcpy(m_modulus, modulus, sizeof(signature_t));
+	}
+
+	// frees the pooled sessions, rsa_context_t is complete here
+	rsa_modulus::~rsa_modulus() = default;
+
+	const mont_modulus_t& rsa_modulus::checked_mont() const
+	{
+		if (m_checked.load(memory_order_acquire)) return m_mont;
+
+		// the first decryption pays for mont_init, not the load
+		lock_guard<mutex> lock(m_lock);
+		if (!m_checked.load(memory_order_relaxed))
+		{
+			mont_modulus_t mont;
+			if (mont_init(mont, m_modulus) && memcmp(&mont, &m_mont, sizeof(mont_modulus_t)))
+				m_mont = mont;
+			m_checked.store(true, memory_order_release);
+		}
+		return m_mont;
+	}
+
+	unique_ptr<rsa_context_t> rsa_modulus::acquire() const
+	{
+		{
+			lock_guard<mutex> lock(m_lock);
+			if (!m_idle.empty())
+			{
+				unique_ptr<rsa_context_t> ctx = move(m_idle.back());
+				m_idle.pop_back();
+				return ctx;
+			}
+		}
+		// set up outside the lock, only the first decryptions of a thread get here
+		return unique_ptr<rsa_context_t>(new rsa_context_t(m_modulus, m_exponent));
+	}
+
+	void rsa_modulus::release(unique_ptr<rsa_context_t> ctx) const
+	{
+		lock_guard<mutex> lock(m_lock);
+		m_idle.push_back(move(ctx));
+	}
+
+	bool rsa_modulus::decrypt(const signature_t& sign, license_t& license) const
+	{
+		if (m_is_mont)
+			return mont_decrypt(checked_mont(), m_exponent, sign, license);
+
+		if (sign[0] == 0) return false;
+
+		unique_ptr<rsa_context_t> ctx = acquire();
+		BI_CTX* BI = ctx->BI;
+		bigint* msg, * emsg;
+		signature_t data;
+
+		memcpy(data, sign, sizeof(signature_t));
+		reverse_block(data, sizeof(signature_t));
+
+		msg = bi_import(BI, data, IDA_RSA_BLOCK_SIZE);
+		emsg = bi_mod_power(BI, msg, ctx->pub);
+		bi_export(BI, emsg, reinterpret_cast<uint8_t*>(&license), IDA_RSA_BLOCK_SIZE);
+		release(move(ctx));
+
+		return !license.zero ? true : false;
+	}
+
+	size_t rsa_modulus::heap_allocs() const
+	{
+		if (m_is_mont) return 0;
+
+		lock_guard<mutex> lock(m_lock);
+		size_t allocs = 0;
+		for (const auto& ctx : m_idle)
+			allocs += static_cast<size_t>(ctx->BI->heap_allocs);
+		return allocs;
+	}
+
+	size_t rsa_modulus::decrypt(const signature_t* signs, license_t* licenses, bool* results,
+		size_t count) const
+	{
+		if (m_is_mont)
+			return mont_decrypt_batch(checked_mont(), m_exponent, signs, licenses, results, count);
+
+		size_t decrypted = 0;
+		for (size_t i = 0; i < count; ++i)
+		{
+			bool ok = decrypt(signs[i], licenses[i]);
+			if (results) results[i] = ok;
+			if (ok) ++decrypted;
+		}
+		return decrypted;
+	}
+
+	size_t rsa_modulus::decrypt_parallel(const signature_t* signs, license_t* licenses,
+		bool* results, size_t count, unsigned threads) const
+	{
+		if (!threads)
+			threads = max(thread::hardware_concurrency(), 1u);
+
+		// keep every worker busy with at least a few simd groups
+		const size_t min_chunk = 64;
+		size_t workers = min(static_cast<size_t>(threads), (count + min_chunk - 1) / min_chunk);
+		if (workers <= 1)
+			return decrypt(signs, licenses, results, count);
+
+		// contiguous slices, the workers share nothing but the modulus
+		vector<size_t> decrypted(workers, 0);
+		vector<thread> pool;
+		pool.reserve(workers - 1);
+
+		size_t chunk = count / workers, rest = count % workers, begin = 0;
+		for (size_t w = 0; w < workers; ++w)
+		{
+			size_t size = chunk + (w < rest ? 1 : 0);
+			auto job = [=, &decrypted]()
+			{
+				decrypted[w] = decrypt(signs + begin, licenses + begin,
+					results ? results + begin : nullptr, size);
+			};
+
+			// the calling thread takes the last slice
+			if (w + 1 == workers)
+				job();
+			else
+				pool.emplace_back(job);
+			begin += size;
+		}
+		for (auto& t : pool)
+			t.join();
+
+		size_t total = 0;
+		for (size_t n : decrypted)
+			total += n;
+		return total;
+	}
+
+	// fnv-1a of the modulus and its exponent
+	static uint32_t modulus_hash(const uint8_t* modulus, uint32_t exponent)
+	{
+		uint32_t hash = 0x811c9dc5;
+		for (size_t i = 0; i < sizeof(signature_t); ++i)
+			hash = (hash ^ modulus[i]) * 0x01000193;
+		for (size_t i = 0; i < sizeof(exponent); ++i)
+			hash = (hash ^ static_cast<uint8_t>(exponent >> (i * 8))) * 0x01000193;
+		return hash;
+	}
+
+	size_t rsa_verifier::add(const uint8_t* modulus, const string& name, uint32_t exponent)
+	{
+		m_mods.emplace_back(new rsa_modulus(modulus, name, exponent));
+		m_fingerprint ^= modulus_hash(modulus, exponent);
+		return m_mods.size() - 1;
+	}
+
+	size_t rsa_verifier::add(const uint8_t* modulus, const mont_modulus_t& mont, const string& name,
+		uint32_t exponent)
+	{
+		m_mods.emplace_back(new rsa_modulus(modulus, mont, name, exponent));
+		m_fingerprint ^= modulus_hash(modulus, exponent);
+		return m_mods.size() - 1;
+	}
+
+	shared_ptr<const rsa_verifier::trial_t> rsa_verifier::get_trial() const
+	{
+		// counters move while other threads decrypt, a stale order only costs trial time
+		shared_ptr<const trial_t> current = atomic_load(&m_trial);
+		if (current && current->order.size() == m_mods.size())
+		{
+			bool ranked = true;
+			for (size_t i = 1; i < current->order.size() && ranked; ++i)
+			{
+				size_t a = current->order[i - 1], b = current->order[i];
+				uint64_t ha = m_mods[a]->hits(), hb = m_mods[b]->hits();
+				ranked = ha > hb || (ha == hb && a < b);
+			}
+			if (ranked) return current;
+		}
+
+		shared_ptr<trial_t> next = make_shared<trial_t>();
+		next->order.resize(m_mods.size());
+		for (size_t i = 0; i < next->order.size(); ++i)
+			next->order[i] = i;
+
+		// sort a snapshot
+		vector<uint64_t> hits(m_mods.size());
+		for (size_t i = 0; i < hits.size(); ++i)
+			hits[i] = m_mods[i]->hits();
+		stable_sort(next->order.begin(), next->order.end(),
+			[&](size_t a, size_t b) { return hits[a] > hits[b]; });
+
+		// lanes share the exponent, anything else goes one by one
+		for (size_t i : next->order)
+		{
+			const rsa_modulus& mod = *m_mods[i];
+			if (!mod.mont() || mod.exponent() != m_mods[0]->exponent())
+			{
+				next->lanes.clear();
+				break;
+			}
+			next->lanes.push_back(mod.mont());
+		}
+
+		current = next;
+		atomic_store(&m_trial, current);
+		return current;
+	}
+
+	int rsa_verifier::hit(int index) const
+	{
+		if (index >= 0)
+			m_mods[index]->m_hits.fetch_add(1, memory_order_relaxed);
+		return index;
+	}
+
+	bool rsa_verifier::add_hit(const string& name) const
+	{
+		for (size_t i = 0; i < m_mods.size(); ++i)
+		{
+			if (m_mods[i]->name() == name)
+			{
+				hit(static_cast<int>(i));
+				return true;
+			}
+		}
+		return false;
+	}
+
+	int rsa_verifier::decrypt(const signature_t& sign, license_t& license, ERsaTrial trial) const
+	{
+		shared_ptr<const trial_t> current = get_trial();
+
+		if (m_mods.size() > 1 && trial == ERsaTrial_Interleaved)
+			return hit(decrypt_interleaved(sign, license, *current));
+
+		for (size_t i : current->order)
+			if (m_mods[i]->decrypt(sign, license))
+				return hit(static_cast<int>(i));
+		return -1;
+	}
+
+	int rsa_verifier::decrypt_interleaved(const signature_t& sign, license_t& license,
+		const trial_t& current) const
+	{
+		if (current.lanes.empty())
+		{
+			for (size_t i : current.order)
+				if (m_mods[i]->decrypt(sign, license))
+					return static_cast<int>(i);
+			return -1;
+		}
+
+		int lane = mont_decrypt_moduli(current.lanes.data(), current.lanes.size(), m_mods[0]->exponent(),
+			sign, license);
+		return lane >= 0 ? static_cast<int>(current.order[lane]) : -1;
+	}
+
+	bool rsa_verifier::load_stats(const path& filepath) const
+	{
+		ifstream file(filepath);
+		if (!file) return false;
+
+		string line;
+		while (getline(file, line))
+		{
+			size_t pos = line.rfind(' ');
+			if (pos == string::npos) continue;
+
+			string name = line.substr(0, pos);
+			uint64_t hits = strtoull(line.c_str() + pos + 1, nullptr, 10);
+			for (auto& mod : m_mods)
+				if (mod->name() == name)
+					mod->m_hits.store(hits, memory_order_relaxed);
+		}
+		return true;
+	}
+
+	void rsa_verifier::copy_stats(const rsa_verifier& other) const
+	{
+		for (auto& mod : m_mods)
+			for (auto& from : other.m_mods)
+				if (mod->name() == from->name())
+					mod->m_hits.store(from->hits(), memory_order_relaxed);
+	}
+
+	bool rsa_verifier::save_stats(const path& filepath) const
+	{
+		ofstream file(filepath, ios::trunc);
+		if (!file) return false;
+
+		for (auto& mod : m_mods)
+			file << mod->name() << ' ' << mod->hits() << '\n';
+		return file.good();
+	}
+}
@@ -0,0 +1,144 @@
+/*
+* IDA Pro rsa signature verifier header
+*
+* RnD, 2021
+*/
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _IDA_RSA_HPP_
+#define _IDA_RSA_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <filesystem>
+
+#include "ida_license.hpp"
+#include "ida_rsa_mont.hpp"
+
+namespace ida
+{
+	using namespace std;
+	using namespace filesystem;
+
+	// bigint session with the modulus already set
+	struct rsa_context_t;
+
+	// known modulus, imported and normalised once
+	// 1024-bit odd moduli use the montgomery kernel, others the bigint session
+	// the modulus is immutable after construction, every thread decrypts with it,
+	// bigint sessions are pooled in the modulus and freed with it
+	class rsa_modulus
+	{
+	public:
+		rsa_modulus(const uint8_t* modulus, const string& name = "",
+			uint32_t exponent = ida_rsa_pub);
+		// montgomery constants already computed, e.g. from a registry file,
+		// the reduction constants are checked on first use and computed again if wrong
+		rsa_modulus(const uint8_t* modulus, const mont_modulus_t& mont, const string& name,
+			uint32_t exponent = ida_rsa_pub);
+		~rsa_modulus();
+
+		rsa_modulus(const rsa_modulus&) = delete;
+		rsa_modulus& operator=(const rsa_modulus&) = delete;
+
+		bool decrypt(const signature_t& sign, license_t& license) const;
+		// same as decrypt_signatures
+		size_t decrypt(const signature_t* signs, license_t* licenses, bool* results,
+			size_t count) const;
+		// the batch split over worker threads, 0 threads = one per core
+		size_t decrypt_parallel(const signature_t* signs, license_t* licenses, bool* results,
+			size_t count, unsigned threads = 0) const;
+
+		const string& name() const { return m_name; }
+		const uint8_t* modulus() const { return m_modulus; }
+		uint32_t exponent() const { return m_exponent; }
+		// signatures matched by the owning verifier
+		uint64_t hits() const { return m_hits.load(memory_order_relaxed); }
+		// nullptr when the modulus uses the bigint session
+		const mont_modulus_t* mont() const { return m_is_mont ? &checked_mont() : nullptr; }
+		// heap allocations made so far by the idle bigint sessions, the montgomery path makes none
+		size_t heap_allocs() const;
+
+	private:
+		string m_name;
+		signature_t m_modulus;
+		uint32_t m_exponent;
+		bool m_is_mont;
+		mutable mont_modulus_t m_mont;
+		mutable atomic<bool> m_checked;
+		mutable atomic<uint64_t> m_hits;
+		// bigint sessions not in use, one per thread that decrypted at the same time
+		mutable mutex m_lock;
+		mutable vector<unique_ptr<rsa_context_t>> m_idle;
+
+		friend class rsa_verifier;
+
+		const mont_modulus_t& checked_mont() const;
+		unique_ptr<rsa_context_t> acquire() const;
+		void release(unique_ptr<rsa_context_t> ctx) const;
+	};
+
+	// how the verifier tries its moduli
+	enum ERsaTrial
+	{
+		ERsaTrial_Sequential = 0,	// one by one in order
+		ERsaTrial_Interleaved,		// one simd lane per modulus
+	};
+
+	// set of moduli, the most matched ones are tried first
+	class rsa_verifier
+	{
+	public:
+		size_t add(const uint8_t* modulus, const string& name,
+			uint32_t exponent = ida_rsa_pub);
+		size_t add(const uint8_t* modulus, const mont_modulus_t& mont, const string& name,
+			uint32_t exponent = ida_rsa_pub);
+
+		// index of the matched modulus or -1, safe to call from many threads
+		int decrypt(const signature_t& sign, license_t& license,
+			ERsaTrial trial = ERsaTrial_Sequential) const;
+
+		// a match found without a trial, e.g. in a cache, counts for the named modulus,
+		// false if the verifier has no such modulus
+		bool add_hit(const string& name) const;
+
+		// hit counts by modulus name, one "name hits" line each
+		bool load_stats(const path& filepath) const;
+		bool save_stats(const path& filepath) const;
+		// hit counts of the same named moduli, kept across a registry reload
+		void copy_stats(const rsa_verifier& other) const;
+
+		// changes with the set of moduli, independent of their order
+		uint32_t fingerprint() const { return m_fingerprint; }
+
+		size_t size() const { return m_mods.size(); }
+		const rsa_modulus& at(size_t index) const { return *m_mods[index]; }
+
+	private:
+		// indices by hits, ties keep the order of add,
+		// with the montgomery constants of each for the simd lanes
+		typedef struct trial_t
+		{
+			vector<size_t> order;
+			vector<const mont_modulus_t*> lanes; // empty unless every modulus can take a lane
+		} trial_t;
+
+		// the cached trial while the hit counts keep its ranks, a new one otherwise
+		shared_ptr<const trial_t> get_trial() const;
+		int decrypt_interleaved(const signature_t& sign, license_t& license, const trial_t& current) const;
+		int hit(int index) const;
+
+		vector<unique_ptr<rsa_modulus>> m_mods;
+		uint32_t m_fingerprint = 0;
+		mutable shared_ptr<const trial_t> m_trial;
+	};
+}
+
+#endif // _IDA_RSA_HPP_
\ No newline at end of file
@@ -0,0 +1,461 @@
+/*
+* Multi-lane montgomery kernels for batches of IDA rsa blocks
+*
+* RnD, 2021
+*/
+
+#include <cstring>
+
+#include "ida_rsa_mont.hpp"
+#include "ida_cpu.hpp"
+
+#if defined(IDA_CPU_X86)
+#include <immintrin.h>
+#endif
+
+#if defined(__clang__)
+#define IDA_UNROLL			_Pragma("unroll")
+#elif defined(__GNUC__)
+#define IDA_UNROLL			_Pragma("GCC unroll 32")
+#else
+#define IDA_UNROLL
+#endif
+
+#define IDA_MONT_LANES_MAX	8
+
+namespace ida
+{
+	// one group of lanes, every lane has its own modulus and block
+	typedef struct mont_lanes_t
+	{
+		const mont_modulus_t* mods[IDA_MONT_LANES_MAX];
+		const uint8_t* signs[IDA_MONT_LANES_MAX];
+		uint8_t* outs[IDA_MONT_LANES_MAX];
+	} mont_lanes_t;
+
+	// r = a mod n for a <= n
+	static void reduce_once(mont_limbs_t& a, const mont_limbs_t& n)
+	{
+		for (size_t i = IDA_MONT_LIMBS; i-- > 0;)
+		{
+			if (a[i] != n[i])
+			{
+				if (a[i] < n[i]) return;
+				break;
+			}
+		}
+		uint64_t borrow = 0;
+		for (size_t i = 0; i < IDA_MONT_LIMBS; ++i)
+		{
+			uint64_t d = a[i] - n[i];
+			uint64_t bw = a[i] < n[i];
+			a[i] = d - borrow;
+			borrow = bw | (d < borrow);
+		}
+	}
+
+	static void scalar_lanes(const mont_lanes_t& lanes, size_t count, uint32_t exponent)
+	{
+		for (size_t l = 0; l < count; ++l)
+		{
+			mont_limbs_t x;
+			mont_import(x, lanes.signs[l]);
+			if (exponent == ida_rsa_pub)
+				mont_pow<ida_rsa_pub>(x, x, *lanes.mods[l]);
+			else
+				mont_pow(x, x, exponent, *lanes.mods[l]);
+			mont_export(x, lanes.outs[l]);
+		}
+	}
+
+#if defined(IDA_CPU_X86)
+	// AVX2: 4 lanes of 32-bit limbs in 64-bit slots, exact CIOS
+	const size_t N32 = IDA_RSA_BLOCK_SIZE / 4;
+	const size_t L4 = 4;
+
+	typedef struct avx2_mod_t
+	{
+		__m256i n[N32];
+		__m256i rr[N32];
+		__m256i n0;
+	} avx2_mod_t;
+
+	IDA_TARGET("avx2")
+	static void avx2_mont_mul(__m256i* r, const __m256i* a, const __m256i* b, const avx2_mod_t& m)
+	{
+		const __m256i mask = _mm256_set1_epi64x(0xffffffff);
+		const __m256i one = _mm256_set1_epi64x(1);
+		__m256i t[N32 + 2];
+		IDA_UNROLL
+		for (size_t j = 0; j < N32 + 2; ++j)
+			t[j] = _mm256_setzero_si256();
+
+		for (size_t i = 0; i < N32; ++i)
+		{
+			__m256i s, c = _mm256_setzero_si256();
+			IDA_UNROLL
+			for (size_t j = 0; j < N32; ++j)
+			{
+				s = _mm256_add_epi64(_mm256_add_epi64(t[j], _mm256_mul_epu32(a[j], b[i])), c);
+				t[j] = _mm256_and_si256(s, mask);
+				c = _mm256_srli_epi64(s, 32);
+			}
+			s = _mm256_add_epi64(t[N32], c);
+			t[N32] = _mm256_and_si256(s, mask);
+			t[N32 + 1] = _mm256_srli_epi64(s, 32);
+
+			__m256i mi = _mm256_and_si256(_mm256_mul_epu32(t[0], m.n0), mask);
+			s = _mm256_add_epi64(t[0], _mm256_mul_epu32(mi, m.n[0]));
+			c = _mm256_srli_epi64(s, 32);
+			IDA_UNROLL
+			for (size_t j = 1; j < N32; ++j)
+			{
+				s = _mm256_add_epi64(_mm256_add_epi64(t[j], _mm256_mul_epu32(mi, m.n[j])), c);
+				t[j - 1] = _mm256_and_si256(s, mask);
+				c = _mm256_srli_epi64(s, 32);
+			}
+			s = _mm256_add_epi64(t[N32], c);
+			t[N32 - 1] = _mm256_and_si256(s, mask);
+			t[N32] = _mm256_add_epi64(t[N32 + 1], _mm256_srli_epi64(s, 32));
+		}
+
+		// t - n per lane, keep t where it was already below n
+		__m256i d[N32];
+		__m256i borrow = _mm256_setzero_si256();
+		IDA_UNROLL
+		for (size_t j = 0; j < N32; ++j)
+		{
+			__m256i s = _mm256_sub_epi64(_mm256_sub_epi64(t[j], m.n[j]), borrow);
+			d[j] = _mm256_and_si256(s, mask);
+			borrow = _mm256_srli_epi64(s, 63);
+		}
+		__m256i keep = _mm256_cmpeq_epi64(_mm256_sub_epi64(borrow, t[N32]), one);
+		IDA_UNROLL
+		for (size_t j = 0; j < N32; ++j)
+			r[j] = _mm256_blendv_epi8(d[j], t[j], keep);
+	}
+
+	IDA_TARGET("avx2")
+	static void avx2_lanes(const mont_lanes_t& lanes, size_t count, uint32_t exponent)
+	{
+		avx2_mod_t m;
+		__m256i x[N32], xm[N32], r[N32], one[N32];
+		alignas(32) uint64_t v[L4][N32];
+		alignas(32) uint64_t w[L4][N32];
+		alignas(32) uint64_t n0[L4];
+
+		// transpose blocks and moduli into lanes
+		for (size_t l = 0; l < L4; ++l)
+		{
+			size_t k = l < count ? l : count - 1;
+			const mont_modulus_t& mod = *lanes.mods[k];
+			n0[l] = mod.n0inv & 0xffffffff;
+			for (size_t j = 0; j < N32; ++j)
+			{
+				v[l][j] = static_cast<uint32_t>(mod.n[j / 2] >> (j % 2 * 32));
+				w[l][j] = static_cast<uint32_t>(mod.rr[j / 2] >> (j % 2 * 32));
+			}
+		}
+		for (size_t j = 0; j < N32; ++j)
+		{
+			m.n[j] = _mm256_set_epi64x(v[3][j], v[2][j], v[1][j], v[0][j]);
+			m.rr[j] = _mm256_set_epi64x(w[3][j], w[2][j], w[1][j], w[0][j]);
+			one[j] = _mm256_setzero_si256();
+		}
+		m.n0 = _mm256_set_epi64x(n0[3], n0[2], n0[1], n0[0]);
+		one[0] = _mm256_set1_epi64x(1);
+
+		for (size_t l = 0; l < L4; ++l)
+		{
+			const uint8_t* sign = lanes.signs[l < count ? l : count - 1];
+			for (size_t j = 0; j < N32; ++j)
+				v[l][j] = static_cast<uint64_t>(sign[j * 4]) |
+					static_cast<uint64_t>(sign[j * 4 + 1]) << 8 |
+					static_cast<uint64_t>(sign[j * 4 + 2]) << 16 |
+					static_cast<uint64_t>(sign[j * 4 + 3]) << 24;
+		}
+		for (size_t j = 0; j < N32; ++j)
+			x[j] = _mm256_set_epi64x(v[3][j], v[2][j], v[1][j], v[0][j]);
+
+		// left-to-right binary in montgomery form
+		avx2_mont_mul(xm, x, m.rr, m);
+		memcpy(r, xm, sizeof(r));
+		int bit = 31;
+		while (!(exponent >> bit & 1)) --bit;
+		while (--bit >= 0)
+		{
+			avx2_mont_mul(r, r, r, m);
+			if (exponent >> bit & 1)
+				avx2_mont_mul(r, r, xm, m);
+		}
+		avx2_mont_mul(r, r, one, m);
+
+		for (size_t j = 0; j < N32; ++j)
+			_mm256_store_si256(reinterpret_cast<__m256i*>(w) + j, r[j]);
+		for (size_t l = 0; l < count; ++l)
+		{
+			const uint64_t* lane = reinterpret_cast<const uint64_t*>(w);
+			for (size_t j = 0; j < N32; ++j)
+			{
+				uint32_t limb = static_cast<uint32_t>(lane[j * L4 + l]);
+				for (size_t b = 0; b < 4; ++b)
+					lanes.outs[l][IDA_RSA_BLOCK_SIZE - 1 - (j * 4 + b)] = static_cast<uint8_t>(limb >> (b * 8));
+			}
+		}
+	}
+
+	// AVX-512 IFMA: 8 lanes of 52-bit limbs, almost montgomery with R' = 2^1040 > 4n
+	const size_t N52 = 20;
+	const size_t L8 = 8;
+	const uint64_t k_mask52 = 0xfffffffffffffull;
+
+	typedef struct ifma_mod_t
+	{
+		__m512i n[N52];
+		__m512i rr[N52];
+		__m512i n0;
+	} ifma_mod_t;
+
+	static void to_limbs52(uint64_t* r, const mont_limbs_t& a)
+	{
+		for (size_t j = 0; j < N52; ++j)
+		{
+			size_t bit = j * 52, i = bit / 64, off = bit % 64;
+			uint64_t v = i < IDA_MONT_LIMBS ? a[i] >> off : 0;
+			if (off > 12 && i + 1 < IDA_MONT_LIMBS)
+				v |= a[i + 1] << (64 - off);
+			r[j] = v & k_mask52;
+		}
+	}
+
+	static void from_limbs52(mont_limbs_t& r, const uint64_t* a)
+	{
+		memset(r, 0, sizeof(mont_limbs_t));
+		for (size_t j = 0; j < N52; ++j)
+		{
+			size_t bit = j * 52, i = bit / 64, off = bit % 64;
+			if (i < IDA_MONT_LIMBS)
+				r[i] |= a[j] << off;
+			if (off > 12 && i + 1 < IDA_MONT_LIMBS)
+				r[i + 1] |= a[j] >> (64 - off);
+		}
+	}
+
+	IDA_TARGET("avx512f,avx512ifma")
+	static void ifma_mont_mul(__m512i* r, const __m512i* a, const __m512i* b, const ifma_mod_t& m)
+	{
+		const __m512i mask = _mm512_set1_epi64(k_mask52);
+		const __m512i zero = _mm512_set1_epi64(0);
+		__m512i t[N52 + 1];
+		IDA_UNROLL
+		for (size_t j = 0; j < N52 + 1; ++j)
+			t[j] = zero;
+
+		for (size_t i = 0; i < N52; ++i)
+		{
+			IDA_UNROLL
+			for (size_t j = 0; j < N52; ++j)
+				t[j] = _mm512_madd52lo_epu64(t[j], a[j], b[i]);
+			IDA_UNROLL
+			for (size_t j = 0; j < N52; ++j)
+				t[j + 1] = _mm512_madd52hi_epu64(t[j + 1], a[j], b[i]);
+
+			__m512i mi = _mm512_and_si512(_mm512_madd52lo_epu64(zero, t[0], m.n0), mask);
+			IDA_UNROLL
+			for (size_t j = 0; j < N52; ++j)
+				t[j] = _mm512_madd52lo_epu64(t[j], m.n[j], mi);
+			IDA_UNROLL
+			for (size_t j = 0; j < N52; ++j)
+				t[j + 1] = _mm512_madd52hi_epu64(t[j + 1], m.n[j], mi);
+
+			// t[0] is a multiple of 2^52 now, shift one limb down
+			__m512i carry = _mm512_srli_epi64(t[0], 52);
+			IDA_UNROLL
+			for (size_t j = 0; j < N52; ++j)
+				t[j] = t[j + 1];
+			t[N52] = zero;
+			t[0] = _mm512_add_epi64(t[0], carry);
+		}
+
+		IDA_UNROLL
+		for (size_t j = 0; j < N52 - 1; ++j)
+		{
+			t[j + 1] = _mm512_add_epi64(t[j + 1], _mm512_srli_epi64(t[j], 52));
+			r[j] = _mm512_and_si512(t[j], mask);
+		}
+		r[N52 - 1] = _mm512_and_si512(t[N52 - 1], mask);
+	}
+
+	IDA_TARGET("avx512f,avx512ifma")
+	static void ifma_lanes(const mont_lanes_t& lanes, size_t count, uint32_t exponent)
+	{
+		ifma_mod_t m;
+		__m512i x[N52], xm[N52], r[N52], one[N52];
+		alignas(64) uint64_t v[N52][L8];
+		alignas(64) uint64_t w[N52][L8];
+		alignas(64) uint64_t n0[L8];
+		uint64_t limbs[N52];
+
+		for (size_t l = 0; l < L8; ++l)
+		{
+			size_t k = l < count ? l : count - 1;
+			const mont_modulus_t& mod = *lanes.mods[k];
+			n0[l] = mod.n0inv & k_mask52;
+			to_limbs52(limbs, mod.n);
+			for (size_t j = 0; j < N52; ++j) v[j][l] = limbs[j];
+			to_limbs52(limbs, mod.rr52);
+			for (size_t j = 0; j < N52; ++j) w[j][l] = limbs[j];
+		}
+		for (size_t j = 0; j < N52; ++j)
+		{
+			m.n[j] = _mm512_load_si512(v[j]);
+			m.rr[j] = _mm512_load_si512(w[j]);
+			one[j] = _mm512_set1_epi64(0);
+		}
+		m.n0 = _mm512_load_si512(n0);
+		one[0] = _mm512_set1_epi64(1);
+
+		for (size_t l = 0; l < L8; ++l)
+		{
+			mont_limbs_t block;
+			mont_import(block, lanes.signs[l < count ? l : count - 1]);
+			to_limbs52(limbs, block);
+			for (size_t j = 0; j < N52; ++j) v[j][l] = limbs[j];
+		}
+		for (size_t j = 0; j < N52; ++j)
+			x[j] = _mm512_load_si512(v[j]);
+
+		// every intermediate stays below 2n, only the final value needs a reduction
+		ifma_mont_mul(xm, x, m.rr, m);
+		memcpy(r, xm, sizeof(r));
+		int bit = 31;
+		while (!(exponent >> bit & 1)) --bit;
+		while (--bit >= 0)
+		{
+			ifma_mont_mul(r, r, r, m);
+			if (exponent >> bit & 1)
+				ifma_mont_mul(r, r, xm, m);
+		}
+		ifma_mont_mul(r, r, one, m);
+
+		for (size_t j = 0; j < N52; ++j)
+			_mm512_store_si512(v[j], r[j]);
+		for (size_t l = 0; l < count; ++l)
+		{
+			mont_limbs_t result;
+			for (size_t j = 0; j < N52; ++j) limbs[j] = v[j][l];
+			from_limbs52(result, limbs);
+			reduce_once(result, lanes.mods[l]->n);
+			mont_export(result, lanes.outs[l]);
+		}
+	}
+#endif
+
+	static size_t kernel_lanes(EMontKernel kernel)
+	{
+		switch (kernel)
+		{
+		case EMontKernel_AVX2:
+			return 4;
+		case EMontKernel_IFMA:
+			return 8;
+		default:
+			return 1;
+		}
+	}
+
+	static void run_lanes(EMontKernel kernel, const mont_lanes_t& lanes, size_t count,
+		uint32_t exponent)
+	{
+#if defined(IDA_CPU_X86)
+		if (exponent)
+		{
+			if (kernel == EMontKernel_IFMA)
+				return ifma_lanes(lanes, count, exponent);
+			if (kernel == EMontKernel_AVX2)
+				return avx2_lanes(lanes, count, exponent);
+		}
+#endif
+		scalar_lanes(lanes, count, exponent);
+	}
+
+	EMontKernel mont_batch_kernel()
+	{
+		if (has_cpu_feature(ECpuFeature_AVX512IFMA)) return EMontKernel_IFMA;
+		if (has_cpu_feature(ECpuFeature_AVX2)) return EMontKernel_AVX2;
+		return EMontKernel_Scalar;
+	}
+
+	size_t mont_decrypt_batch(const mont_modulus_t& mod, uint32_t exponent,
+		const signature_t* signs, license_t* licenses, bool* results, size_t count,
+		EMontKernel kernel)
+	{
+		size_t width = kernel_lanes(kernel);
+		size_t decrypted = 0;
+		size_t used = 0;
+		size_t index[IDA_MONT_LANES_MAX];
+		mont_lanes_t lanes;
+
+		for (size_t i = 0; i <= count; ++i)
+		{
+			// flush a full group, or the tail
+			if (used == width || (i == count && used))
+			{
+				run_lanes(kernel, lanes, used, exponent);
+				for (size_t l = 0; l < used; ++l)
+				{
+					bool ok = !licenses[index[l]].zero;
+					if (results) results[index[l]] = ok;
+					if (ok) ++decrypted;
+				}
+				used = 0;
+			}
+			if (i == count) break;
+
+			if (signs[i][0] == 0)
+			{
+				if (results) results[i] = false;
+				continue;
+			}
+			index[used] = i;
+			lanes.mods[used] = &mod;
+			lanes.signs[used] = signs[i];
+			lanes.outs[used] = reinterpret_cast<uint8_t*>(&licenses[i]);
+			++used;
+		}
+		return decrypted;
+	}
+
+	int mont_decrypt_moduli(const mont_modulus_t* const* mods, size_t count, uint32_t exponent,
+		const signature_t& sign, license_t& license, EMontKernel kernel)
+	{
+		if (sign[0] == 0) return -1;
+
+		size_t width = kernel_lanes(kernel);
+		license_t outs[IDA_MONT_LANES_MAX];
+		mont_lanes_t lanes;
+
+		for (size_t first = 0; first < count; first += width)
+		{
+			size_t used = count - first < width ? count - first : width;
+			for (size_t l = 0; l < used; ++l)
+			{
+				lanes.mods[l] = mods[first + l];
+				lanes.signs[l] = sign;
+				lanes.outs[l] = reinterpret_cast<uint8_t*>(&outs[l]);
+			}
+			run_lanes(kernel, lanes, used, exponent);
+
+			// the earliest modulus wins, later groups are not evaluated
+			for (size_t l = 0; l < used; ++l)
+			{
+				if (!outs[l].zero)
+				{
+					memcpy(&license, &outs[l], sizeof(license_t));
+					return static_cast<int>(first + l);
+				}
+			}
+		}
+		return -1;
+	}
+}
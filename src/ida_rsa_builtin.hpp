@@ -0,0 +1,38 @@
+/*
+* Built-in rsa moduli with compile-time montgomery constants header
+*
+* RnD, 2021
+*/
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _IDA_RSA_BUILTIN_HPP_
+#define _IDA_RSA_BUILTIN_HPP_
+
+#include <iterator>
+
+#include "ida_license.hpp"
+#include "ida_rsa_mont.hpp"
+#include "ida_rsa_patches.h"
+
+namespace ida
+{
+	// ready to use without any setup, one copy per program
+	inline constexpr mont_modulus_t k_mont_official = mont_make(ida_rsa_mod);
+
+	inline constexpr mont_modulus_t k_mont_patches[] = {
+		mont_make(rsa_mod_patch_1),
+		mont_make(rsa_mod_patch_2),
+		mont_make(rsa_mod_patch_3)
+	};
+
+	static_assert(std::size(k_mont_patches) == std::size(k_patch_mods), "one constant set per patch");
+	static_assert((k_mont_official.n[0] & 1) != 0, "montgomery needs an odd modulus");
+	static_assert((k_mont_patches[0].n[0] & 1) != 0, "montgomery needs an odd modulus");
+	static_assert((k_mont_patches[1].n[0] & 1) != 0, "montgomery needs an odd modulus");
+	static_assert((k_mont_patches[2].n[0] & 1) != 0, "montgomery needs an odd modulus");
+}
+
+#endif // _IDA_RSA_BUILTIN_HPP_
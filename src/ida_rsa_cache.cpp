@@ -0,0 +1,261 @@
+/*
+* Persistent signature decryption cache
+*
+* RnD, 2021
+*/
+
+#include <cstring>
+#include <cstddef>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+#include <array>
+
+#include "ida_rsa_cache.hpp"
+#include "md5.hpp"
+
+namespace ida
+{
+	static_assert(sizeof(cache_header_t) % 8 == 0, "slots must stay 8-byte aligned");
+	static_assert(sizeof(cache_slot_t) % 8 == 0, "slots must stay 8-byte aligned");
+
+	static void sign_digest(const signature_t& sign, md5_t& digest)
+	{
+		MD5_CTX ctx;
+		MD5_Init(&ctx);
+		MD5_Update(&ctx, sign, sizeof(signature_t));
+		MD5_Final(digest, &ctx);
+	}
+
+	// fnv-1a of everything but the checksum itself
+	static uint32_t slot_checksum(const cache_slot_t& slot)
+	{
+		const uint8_t* data = reinterpret_cast<const uint8_t*>(&slot);
+		uint32_t hash = 0x811c9dc5;
+		for (size_t i = 0; i < offsetof(cache_slot_t, checksum); ++i)
+			hash = (hash ^ data[i]) * 0x01000193;
+		return hash;
+	}
+
+	// digest as a map key, md5 bits are already uniform
+	typedef array<uint8_t, sizeof(md5_t)> digest_key_t;
+
+	typedef struct digest_hash_t
+	{
+		size_t operator()(const digest_key_t& key) const
+		{
+			size_t hash;
+			memcpy(&hash, key.data(), sizeof(hash));
+			return hash;
+		}
+	} digest_hash_t;
+
+	static bool is_empty_key(const md5_t& key)
+	{
+		static const md5_t empty = { 0 };
+		return !memcmp(key, empty, sizeof(md5_t));
+	}
+
+	bool rsa_cache::open(const path& filepath, uint32_t slots)
+	{
+		close();
+
+		if (!slots || (slots & (slots - 1))) return false;
+		if (!m_file.open_shared(filepath, sizeof(cache_header_t) + slots * sizeof(cache_slot_t)))
+			return false;
+
+		if (!m_file.lock())
+		{
+			m_file.close();
+			return false;
+		}
+
+		// a fresh file is all zeros, the first process writes the header
+		cache_header_t* header = reinterpret_cast<cache_header_t*>(m_file.writable_data());
+		if (!header->magic)
+		{
+			header->version = IDA_CACHE_VERSION;
+			header->slots = slots;
+			header->slot_size = sizeof(cache_slot_t);
+			atomic_thread_fence(memory_order_release);
+			header->magic = IDA_CACHE_MAGIC;
+		}
+
+		bool valid = header->magic == IDA_CACHE_MAGIC &&
+			header->version == IDA_CACHE_VERSION &&
+			header->slot_size == sizeof(cache_slot_t) &&
+			header->slots && !(header->slots & (header->slots - 1)) &&
+			header->slots <= (m_file.size() - sizeof(cache_header_t)) / sizeof(cache_slot_t);
+		m_file.unlock();
+
+		if (!valid)
+		{
+			m_file.close();
+			return false;
+		}
+
+		m_count = header->slots;
+		m_header = header;
+		m_slots = reinterpret_cast<cache_slot_t*>(m_file.writable_data() + sizeof(cache_header_t));
+		return true;
+	}
+
+	bool rsa_cache::lookup(const signature_t& sign, uint32_t fingerprint, cache_entry_t& entry) const
+	{
+		md5_t key;
+		sign_digest(sign, key);
+		return lookup(key, fingerprint, entry);
+	}
+
+	bool rsa_cache::lookup(const md5_t& key, uint32_t fingerprint, cache_entry_t& entry) const
+	{
+		if (!m_slots) return false;
+
+		uint32_t home;
+		memcpy(&home, key, sizeof(home));
+		for (uint32_t probe = 0; probe < IDA_CACHE_PROBES; ++probe)
+		{
+			const cache_slot_t& slot = m_slots[(home + probe) & (m_count - 1)];
+
+			md5_t current;
+			memcpy(current, slot.key, sizeof(md5_t));
+			if (is_empty_key(current)) return false;
+			if (memcmp(current, key, sizeof(md5_t))) continue;
+
+			// the key is written last, a torn or foreign slot fails the checksum
+			atomic_thread_fence(memory_order_acquire);
+			cache_slot_t copy;
+			memcpy(&copy, &slot, sizeof(cache_slot_t));
+			if (memcmp(copy.key, key, sizeof(md5_t)) || copy.checksum != slot_checksum(copy))
+				return false;
+
+			if (!(copy.entry.flags & ECacheFlag_Decrypted) && copy.fingerprint != fingerprint)
+				return false;
+
+			memcpy(&entry, &copy.entry, sizeof(cache_entry_t));
+			return true;
+		}
+		return false;
+	}
+
+	bool rsa_cache::insert(const signature_t& sign, uint32_t fingerprint, const cache_entry_t& entry)
+	{
+		md5_t key;
+		sign_digest(sign, key);
+		return insert(key, fingerprint, entry);
+	}
+
+	bool rsa_cache::insert(const md5_t& key, uint32_t fingerprint, const cache_entry_t& entry)
+	{
+		if (!m_slots) return false;
+
+		cache_slot_t value;
+		memset(&value, 0, sizeof(cache_slot_t));
+		memcpy(value.key, key, sizeof(md5_t));
+		memcpy(&value.entry, &entry, sizeof(cache_entry_t));
+		value.fingerprint = fingerprint;
+
+		lock_guard<mutex> guard(m_lock);
+		if (!m_file.lock()) return false;
+
+		// the same key or the first empty slot, the oldest one of a full window
+		uint32_t home;
+		memcpy(&home, key, sizeof(home));
+		cache_slot_t* slot = nullptr;
+		cache_slot_t* oldest = nullptr;
+		for (uint32_t probe = 0; probe < IDA_CACHE_PROBES && !slot; ++probe)
+		{
+			cache_slot_t& current = m_slots[(home + probe) & (m_count - 1)];
+			if (is_empty_key(current.key) || !memcmp(current.key, key, sizeof(md5_t)))
+				slot = &current;
+			else if (!oldest || m_header->clock - current.stamp > m_header->clock - oldest->stamp)
+				oldest = &current;
+		}
+		if (!slot)
+		{
+			slot = oldest;
+			++m_header->full;
+		}
+		value.stamp = m_header->clock++;
+		value.checksum = slot_checksum(value);
+
+		// readers skip the slot while its key is cleared
+		if (!is_empty_key(slot->key))
+		{
+			memset(slot->key, 0, sizeof(md5_t));
+			atomic_thread_fence(memory_order_release);
+		}
+		memcpy(reinterpret_cast<uint8_t*>(slot) + sizeof(md5_t),
+			reinterpret_cast<const uint8_t*>(&value) + sizeof(md5_t),
+			sizeof(cache_slot_t) - sizeof(md5_t));
+		atomic_thread_fence(memory_order_release);
+		memcpy(slot->key, key, sizeof(md5_t));
+
+		m_file.unlock();
+		return true;
+	}
+
+	bool decrypt_entry(const rsa_verifier& verifier, const signature_t& sign, cache_entry_t& entry,
+		ERsaTrial trial)
+	{
+		memset(&entry, 0, sizeof(cache_entry_t));
+		entry.flags = ECacheFlag_Pirated;
+
+		int index = verifier.decrypt(sign, entry.license, trial);
+		if (index < 0) return false;
+
+		const rsa_modulus& mod = verifier.at(index);
+		entry.flags = ECacheFlag_Decrypted;
+		if (memcmp(mod.modulus(), ida_rsa_mod, sizeof(signature_t)))
+			entry.flags |= ECacheFlag_Pirated;
+
+		size_t length = mod.name().size() < sizeof(entry.modulus) ? mod.name().size() : sizeof(entry.modulus) - 1;
+		memcpy(entry.modulus, mod.name().c_str(), length);
+		return true;
+	}
+
+	size_t rsa_cache::decrypt(const rsa_verifier& verifier, const signature_t* signs,
+		cache_entry_t* entries, size_t count, ERsaTrial trial)
+	{
+		uint32_t fingerprint = verifier.fingerprint();
+		unordered_map<digest_key_t, size_t, digest_hash_t> seen;
+		size_t decrypted = 0;
+		m_hits = 0;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			md5_t digest;
+			digest_key_t key;
+			sign_digest(signs[i], digest);
+			memcpy(key.data(), digest, sizeof(md5_t));
+
+			// the same block earlier in this batch
+			auto it = seen.find(key);
+			if (it != seen.end())
+			{
+				memcpy(&entries[i], &entries[it->second], sizeof(cache_entry_t));
+				if (entries[i].flags & ECacheFlag_Decrypted)
+					verifier.add_hit(entries[i].modulus);
+			}
+			else
+			{
+				seen.emplace(key, i);
+				if (lookup(digest, fingerprint, entries[i]))
+				{
+					++m_hits;
+					// the trial order and the saved stats see cached matches too
+					if (entries[i].flags & ECacheFlag_Decrypted)
+						verifier.add_hit(entries[i].modulus);
+				}
+				else
+				{
+					decrypt_entry(verifier, signs[i], entries[i], trial);
+					insert(digest, fingerprint, entries[i]);
+				}
+			}
+
+			if (entries[i].flags & ECacheFlag_Decrypted) ++decrypted;
+		}
+		return decrypted;
+	}
+}
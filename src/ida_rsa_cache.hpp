@@ -0,0 +1,110 @@
+/*
+* Persistent signature decryption cache header
+*
+* RnD, 2021
+*/
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _IDA_RSA_CACHE_HPP_
+#define _IDA_RSA_CACHE_HPP_
+
+#include <cstdint>
+#include <mutex>
+#include <filesystem>
+
+#include "ida_license.hpp"
+#include "ida_rsa.hpp"
+#include "ida_rsa_registry.hpp"
+#include "ida_mapped_file.hpp"
+
+#define IDA_CACHE_MAGIC			0x43534449 // "IDSC"
+#define IDA_CACHE_VERSION		2
+#define IDA_CACHE_SLOTS			(1 << 16)
+#define IDA_CACHE_PROBES		32
+
+namespace ida
+{
+	using namespace std;
+	using namespace filesystem;
+
+	enum ECacheFlag
+	{
+		ECacheFlag_Decrypted = 1 << 0,
+		ECacheFlag_Pirated = 1 << 1,
+	};
+
+	// what decrypt_sign learned about one signature
+	typedef struct cache_entry_t
+	{
+		license_t license;
+		char modulus[IDA_REGISTRY_NAME_SIZE]; // matched modulus name, empty if not decrypted
+		uint32_t flags;
+	} cache_entry_t;
+
+	// file layout: header, then a power of two open addressing slots
+	typedef struct cache_header_t
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t slots;
+		uint32_t slot_size;
+		uint32_t clock;			// inserts so far, stamps the slots
+		uint32_t full;			// inserts that found the probe window full and replaced the oldest slot
+	} cache_header_t;
+
+	typedef struct cache_slot_t
+	{
+		md5_t key;				// digest of the signature, zero when empty, written last
+		cache_entry_t entry;
+		uint32_t fingerprint;	// verifier a miss was computed with
+		uint32_t stamp;			// header clock when written
+		uint32_t checksum;		// over key, entry and fingerprint
+	} cache_slot_t;
+
+	// signature -> license cache in a file shared by processes,
+	// lookups read the mapping without locks, inserts take the file lock
+	class rsa_cache
+	{
+	public:
+		// creates the file if needed, an existing one keeps its slot count
+		bool open(const path& filepath, uint32_t slots = IDA_CACHE_SLOTS);
+		void close() { m_file.close(); m_header = nullptr; m_slots = nullptr; m_count = 0; }
+		bool is_open() const { return m_slots != nullptr; }
+
+		// misses cached with another set of moduli do not count
+		bool lookup(const signature_t& sign, uint32_t fingerprint, cache_entry_t& entry) const;
+		// a full probe window loses its oldest slot, false if the file lock fails
+		bool insert(const signature_t& sign, uint32_t fingerprint, const cache_entry_t& entry);
+
+		// lookups, then one verifier trial per distinct missing signature,
+		// cached matches count as hits of the verifier moduli,
+		// returns the number of decrypted entries
+		size_t decrypt(const rsa_verifier& verifier, const signature_t* signs, cache_entry_t* entries,
+			size_t count, ERsaTrial trial = ERsaTrial_Sequential);
+
+		// hits of the last decrypt
+		size_t hits() const { return m_hits; }
+		// slots replaced because their probe window was full, by every process
+		uint32_t full() const { return m_header ? m_header->full : 0; }
+
+	private:
+		bool lookup(const md5_t& key, uint32_t fingerprint, cache_entry_t& entry) const;
+		bool insert(const md5_t& key, uint32_t fingerprint, const cache_entry_t& entry);
+
+		mapped_file m_file;
+		cache_header_t* m_header = nullptr;
+		cache_slot_t* m_slots = nullptr;
+		uint32_t m_count = 0;
+		size_t m_hits = 0;
+		mutex m_lock; // the file lock does not separate threads of one process
+	};
+
+	// decrypt one signature with a verifier and fill an entry
+	bool decrypt_entry(const rsa_verifier& verifier, const signature_t& sign, cache_entry_t& entry,
+		ERsaTrial trial = ERsaTrial_Sequential);
+}
+
+#endif // _IDA_RSA_CACHE_HPP_
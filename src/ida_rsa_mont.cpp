@@ -0,0 +1,232 @@
+/*
+* Fixed-width montgomery arithmetic for IDA rsa blocks
+*
+* RnD, 2021
+*/
+
+#include <cstring>
+
+#include "ida_rsa_mont.hpp"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#if defined(__clang__)
+#define IDA_UNROLL			_Pragma("unroll")
+#elif defined(__GNUC__)
+#define IDA_UNROLL			_Pragma("GCC unroll 32")
+#else
+#define IDA_UNROLL
+#endif
+
+namespace ida
+{
+	const size_t N = IDA_MONT_LIMBS;
+
+	// lo(a * b + c + carry), carry = hi(a * b + c + carry)
+	static inline uint64_t mac(uint64_t a, uint64_t b, uint64_t c, uint64_t& carry)
+	{
+#if defined(__SIZEOF_INT128__)
+		unsigned __int128 t = static_cast<unsigned __int128>(a) * b + c + carry;
+		carry = static_cast<uint64_t>(t >> 64);
+		return static_cast<uint64_t>(t);
+#elif defined(_MSC_VER) && defined(_M_X64)
+		uint64_t hi;
+		uint64_t lo = _umul128(a, b, &hi);
+		lo += c; hi += lo < c;
+		lo += carry; hi += lo < carry;
+		carry = hi;
+		return lo;
+#else
+		uint64_t a0 = a & 0xffffffff, a1 = a >> 32;
+		uint64_t b0 = b & 0xffffffff, b1 = b >> 32;
+		uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+		uint64_t mid = (p00 >> 32) + (p01 & 0xffffffff) + (p10 & 0xffffffff);
+		uint64_t lo = (mid << 32) | (p00 & 0xffffffff);
+		uint64_t hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+		lo += c; hi += lo < c;
+		lo += carry; hi += lo < carry;
+		carry = hi;
+		return lo;
+#endif
+	}
+
+	// r = a - b, returns borrow
+	static inline uint64_t sub_n(uint64_t* r, const uint64_t* a, const uint64_t* b)
+	{
+		uint64_t borrow = 0;
+		IDA_UNROLL
+		for (size_t i = 0; i < N; ++i)
+		{
+			uint64_t d = a[i] - b[i];
+			uint64_t bw = a[i] < b[i];
+			r[i] = d - borrow;
+			borrow = bw | (d < borrow);
+		}
+		return borrow;
+	}
+
+	// t[N..2N) = t / R mod n with a final conditional subtraction
+	static inline void redc(mont_limbs_t& r, uint64_t* t, const mont_modulus_t& mod)
+	{
+		uint64_t hi = 0;
+		IDA_UNROLL
+		for (size_t i = 0; i < N; ++i)
+		{
+			uint64_t m = t[i] * mod.n0inv;
+			uint64_t carry = 0;
+			IDA_UNROLL
+			for (size_t j = 0; j < N; ++j)
+				t[i + j] = mac(m, mod.n[j], t[i + j], carry);
+
+			uint64_t s = t[i + N] + carry;
+			uint64_t c = s < carry;
+			s += hi;
+			c += s < hi;
+			t[i + N] = s;
+			hi = c;
+		}
+
+		uint64_t d[N];
+		uint64_t borrow = sub_n(d, t + N, mod.n);
+		// keep t when it was already below n
+		uint64_t mask = static_cast<uint64_t>(0) - (borrow & (hi ^ 1));
+		IDA_UNROLL
+		for (size_t i = 0; i < N; ++i)
+			r[i] = (t[N + i] & mask) | (d[i] & ~mask);
+	}
+
+	void mont_mul(mont_limbs_t& r, const mont_limbs_t& a, const mont_limbs_t& b,
+		const mont_modulus_t& mod)
+	{
+		uint64_t t[2 * N] = { 0 };
+		IDA_UNROLL
+		for (size_t i = 0; i < N; ++i)
+		{
+			uint64_t carry = 0;
+			IDA_UNROLL
+			for (size_t j = 0; j < N; ++j)
+				t[i + j] = mac(a[j], b[i], t[i + j], carry);
+			t[i + N] = carry;
+		}
+		redc(r, t, mod);
+	}
+
+	void mont_sqr(mont_limbs_t& r, const mont_limbs_t& a, const mont_modulus_t& mod)
+	{
+		uint64_t t[2 * N] = { 0 };
+
+		// cross products once
+		IDA_UNROLL
+		for (size_t i = 0; i < N - 1; ++i)
+		{
+			uint64_t carry = 0;
+			IDA_UNROLL
+			for (size_t j = i + 1; j < N; ++j)
+				t[i + j] = mac(a[j], a[i], t[i + j], carry);
+			t[i + N] = carry;
+		}
+
+		// double them
+		uint64_t top = 0;
+		IDA_UNROLL
+		for (size_t i = 0; i < 2 * N; ++i)
+		{
+			uint64_t v = t[i];
+			t[i] = (v << 1) | top;
+			top = v >> 63;
+		}
+
+		// add the diagonal
+		uint64_t carry = 0;
+		IDA_UNROLL
+		for (size_t i = 0; i < N; ++i)
+		{
+			uint64_t hi = 0;
+			uint64_t lo = mac(a[i], a[i], t[2 * i], hi);
+			uint64_t s = lo + carry;
+			hi += s < carry;
+			t[2 * i] = s;
+
+			s = t[2 * i + 1] + hi;
+			carry = s < hi;
+			t[2 * i + 1] = s;
+		}
+		redc(r, t, mod);
+	}
+
+	void mont_import(mont_limbs_t& r, const uint8_t* data)
+	{
+		for (size_t i = 0; i < N; ++i)
+		{
+			uint64_t v = 0;
+			for (size_t j = 0; j < 8; ++j)
+				v |= static_cast<uint64_t>(data[i * 8 + j]) << (j * 8);
+			r[i] = v;
+		}
+	}
+
+	void mont_export(const mont_limbs_t& a, uint8_t* data)
+	{
+		for (size_t i = 0; i < N; ++i)
+			for (size_t j = 0; j < 8; ++j)
+				data[IDA_RSA_BLOCK_SIZE - 1 - (i * 8 + j)] = static_cast<uint8_t>(a[i] >> (j * 8));
+	}
+
+	bool mont_init(mont_modulus_t& mod, const uint8_t* modulus)
+	{
+		memset(&mod, 0, sizeof(mont_modulus_t));
+		mont_import(mod.n, modulus);
+
+		if (!(mod.n[0] & 1)) return false;
+
+		// same setup the built-in moduli get at compile time
+		mod = mont_make(modulus);
+		return true;
+	}
+
+	void mont_pow(mont_limbs_t& r, const mont_limbs_t& x, uint32_t exponent,
+		const mont_modulus_t& mod)
+	{
+		mont_limbs_t xm, one = { 1 };
+
+		if (!exponent)
+		{
+			// 1 mod n
+			mont_mul(r, mod.rr, one, mod);
+			mont_mul(r, r, one, mod);
+			return;
+		}
+
+		// left-to-right binary in montgomery form
+		mont_mul(xm, x, mod.rr, mod);
+		memcpy(r, xm, sizeof(mont_limbs_t));
+
+		int bit = 31;
+		while (!(exponent >> bit & 1)) --bit;
+		while (--bit >= 0)
+		{
+			mont_sqr(r, r, mod);
+			if (exponent >> bit & 1)
+				mont_mul(r, r, xm, mod);
+		}
+		mont_mul(r, r, one, mod);
+	}
+
+	bool mont_decrypt(const mont_modulus_t& mod, uint32_t exponent,
+		const signature_t& sign, license_t& license)
+	{
+		if (sign[0] == 0) return false;
+
+		mont_limbs_t x;
+		mont_import(x, sign);
+		if (exponent == ida_rsa_pub)
+			mont_pow<ida_rsa_pub>(x, x, mod);
+		else
+			mont_pow(x, x, exponent, mod);
+		mont_export(x, reinterpret_cast<uint8_t*>(&license));
+
+		return !license.zero ? true : false;
+	}
+}
\ No newline at end of file
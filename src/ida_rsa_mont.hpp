@@ -0,0 +1,231 @@
+/*
+* Fixed-width montgomery arithmetic for IDA rsa blocks header
+*
+* RnD, 2021
+*/
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _IDA_RSA_MONT_HPP_
+#define _IDA_RSA_MONT_HPP_
+
+#include <cstdint>
+#include <cstring>
+
+#include "ida_license.hpp"
+
+// 64-bit limbs per rsa block
+#define IDA_MONT_LIMBS			(IDA_RSA_BLOCK_SIZE / 8)
+
+namespace ida
+{
+	typedef uint64_t mont_limbs_t[IDA_MONT_LIMBS]; // little-endian limbs
+
+	typedef struct mont_modulus_t
+	{
+		mont_limbs_t n;		// modulus
+		mont_limbs_t rr;	// R^2 mod n, R = 2^1024
+		mont_limbs_t rr52;	// R'^2 mod n for the 52-bit lane kernel, R' = 2^1040
+		uint64_t n0inv;		// -n^-1 mod 2^64
+	} mont_modulus_t;
+
+	// modulus in ida byte order (little-endian), false if it is even
+	bool mont_init(mont_modulus_t& mod, const uint8_t* modulus);
+
+	// compile-time setup, 32-bit partial products so every compiler can evaluate it
+
+	// lo(a * b + c + carry), carry = hi(a * b + c + carry)
+	constexpr uint64_t mont_mac_c(uint64_t a, uint64_t b, uint64_t c, uint64_t& carry)
+	{
+		uint64_t a0 = a & 0xffffffff, a1 = a >> 32;
+		uint64_t b0 = b & 0xffffffff, b1 = b >> 32;
+		uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+		uint64_t mid = (p00 >> 32) + (p01 & 0xffffffff) + (p10 & 0xffffffff);
+		uint64_t lo = (mid << 32) | (p00 & 0xffffffff);
+		uint64_t hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+		lo += c; hi += lo < c;
+		lo += carry; hi += lo < carry;
+		carry = hi;
+		return lo;
+	}
+
+	// r = t - n if t >= n (top is the bit above t), r may alias t
+	constexpr void mont_reduce_c(mont_limbs_t& r, const uint64_t* t, uint64_t top,
+		const mont_limbs_t& n)
+	{
+		uint64_t d[IDA_MONT_LIMBS] = {};
+		uint64_t borrow = 0;
+		for (size_t i = 0; i < IDA_MONT_LIMBS; ++i)
+		{
+			uint64_t v = t[i] - n[i];
+			uint64_t bw = t[i] < n[i];
+			d[i] = v - borrow;
+			borrow = bw | (v < borrow);
+		}
+		bool sub = top || !borrow;
+		for (size_t i = 0; i < IDA_MONT_LIMBS; ++i)
+			r[i] = sub ? d[i] : t[i];
+	}
+
+	// r = 2 * r mod n
+	constexpr void mont_double_c(mont_limbs_t& r, const mont_limbs_t& n)
+	{
+		uint64_t t[IDA_MONT_LIMBS] = {};
+		uint64_t top = 0;
+		for (size_t i = 0; i < IDA_MONT_LIMBS; ++i)
+		{
+			t[i] = (r[i] << 1) | top;
+			top = r[i] >> 63;
+		}
+		mont_reduce_c(r, t, top, n);
+	}
+
+	// r = a * b / R mod n, CIOS, r may alias a or b
+	constexpr void mont_mul_c(mont_limbs_t& r, const mont_limbs_t& a, const mont_limbs_t& b,
+		const mont_limbs_t& n, uint64_t n0inv)
+	{
+		const size_t N = IDA_MONT_LIMBS;
+		uint64_t t[IDA_MONT_LIMBS + 2] = {};
+		for (size_t i = 0; i < N; ++i)
+		{
+			uint64_t carry = 0;
+			for (size_t j = 0; j < N; ++j)
+				t[j] = mont_mac_c(a[j], b[i], t[j], carry);
+			uint64_t s = t[N] + carry;
+			t[N + 1] = s < carry;
+			t[N] = s;
+
+			uint64_t m = t[0] * n0inv;
+			carry = 0;
+			mont_mac_c(m, n[0], t[0], carry);
+			for (size_t j = 1; j < N; ++j)
+				t[j - 1] = mont_mac_c(m, n[j], t[j], carry);
+			s = t[N] + carry;
+			t[N - 1] = s;
+			t[N] = t[N + 1] + (s < carry);
+		}
+		mont_reduce_c(r, t, t[N], n);
+	}
+
+	// mont_init for an odd modulus as a constant expression
+	constexpr mont_modulus_t mont_make(const uint8_t* modulus)
+	{
+		mont_modulus_t mod = {};
+		for (size_t i = 0; i < IDA_MONT_LIMBS; ++i)
+			for (size_t j = 0; j < 8; ++j)
+				mod.n[i] |= static_cast<uint64_t>(modulus[i * 8 + j]) << (j * 8);
+
+		// newton iteration, each step doubles the correct low bits
+		uint64_t inv = mod.n[0];
+		for (int i = 0; i < 5; ++i)
+			inv *= 2 - mod.n[0] * inv;
+		mod.n0inv = static_cast<uint64_t>(0) - inv;
+
+		// R mod n from the top bit of n by doubling
+		size_t top = IDA_MONT_LIMBS * 64 - 1;
+		while (top && !(mod.n[top / 64] >> (top % 64) & 1)) --top;
+		mont_limbs_t x = {};
+		x[top / 64] = static_cast<uint64_t>(1) << (top % 64);
+		for (size_t i = top; i < IDA_MONT_LIMBS * 64; ++i)
+			mont_double_c(x, mod.n);
+
+		// 2^64 in montgomery form, squared 4 times is 2^1024 * R = R^2 mod n
+		for (size_t i = 0; i < 64; ++i)
+			mont_double_c(x, mod.n);
+		for (size_t i = 0; i < 4; ++i)
+			mont_mul_c(x, x, x, mod.n, mod.n0inv);
+
+		for (size_t i = 0; i < IDA_MONT_LIMBS; ++i)
+			mod.rr[i] = mod.rr52[i] = x[i];
+
+		// R'^2 = R^2 * 2^32
+		for (size_t i = 0; i < 32; ++i)
+			mont_double_c(mod.rr52, mod.n);
+		return mod;
+	}
+
+	// r = a * b / R mod n, r may alias a or b
+	void mont_mul(mont_limbs_t& r, const mont_limbs_t& a, const mont_limbs_t& b,
+		const mont_modulus_t& mod);
+	// r = a * a / R mod n, r may alias a
+	void mont_sqr(mont_limbs_t& r, const mont_limbs_t& a, const mont_modulus_t& mod);
+
+	// r = x^e mod n for a plain (not montgomery) x < R
+	void mont_pow(mont_limbs_t& r, const mont_limbs_t& x, uint32_t exponent,
+		const mont_modulus_t& mod);
+
+	// left-to-right binary chain unrolled at compile time
+	template<uint32_t E, int Bit>
+	struct mont_chain_t
+	{
+		static inline void step(mont_limbs_t& r, const mont_limbs_t& xm,
+			const mont_modulus_t& mod)
+		{
+			mont_sqr(r, r, mod);
+			if constexpr (((E >> Bit) & 1) != 0)
+				mont_mul(r, r, xm, mod);
+			mont_chain_t<E, Bit - 1>::step(r, xm, mod);
+		}
+	};
+
+	template<uint32_t E>
+	struct mont_chain_t<E, -1>
+	{
+		static inline void step(mont_limbs_t&, const mont_limbs_t&, const mont_modulus_t&)
+		{}
+	};
+
+	constexpr int mont_top_bit(uint32_t e)
+	{
+		return e > 1 ? 1 + mont_top_bit(e >> 1) : 0;
+	}
+
+	// r = x^E mod n for a compile-time exponent, e.g. 0x13 is 4 squarings and 2 multiplies
+	template<uint32_t E>
+	inline void mont_pow(mont_limbs_t& r, const mont_limbs_t& x, const mont_modulus_t& mod)
+	{
+		static_assert(E != 0, "zero exponent");
+
+		mont_limbs_t xm, one = { 1 };
+		mont_mul(xm, x, mod.rr, mod);
+		memcpy(r, xm, sizeof(mont_limbs_t));
+
+		mont_chain_t<E, mont_top_bit(E) - 1>::step(r, xm, mod);
+		mont_mul(r, r, one, mod);
+	}
+
+	// same contract as decrypt_signature
+	bool mont_decrypt(const mont_modulus_t& mod, uint32_t exponent,
+		const signature_t& sign, license_t& license);
+
+	enum EMontKernel
+	{
+		EMontKernel_Scalar,	// one block at a time
+		EMontKernel_AVX2,	// 4 lanes, 32-bit limbs
+		EMontKernel_IFMA,	// 8 lanes, 52-bit limbs
+	};
+
+	// best kernel for this cpu
+	EMontKernel mont_batch_kernel();
+
+	// same contract per entry as mont_decrypt, results may be nullptr,
+	// returns the number of decrypted entries
+	size_t mont_decrypt_batch(const mont_modulus_t& mod, uint32_t exponent,
+		const signature_t* signs, license_t* licenses, bool* results, size_t count,
+		EMontKernel kernel = mont_batch_kernel());
+
+	// one block under several moduli at once, one modulus per lane,
+	// stops after the lane group that produced a license,
+	// returns the index of the first modulus that decrypted it or -1
+	int mont_decrypt_moduli(const mont_modulus_t* const* mods, size_t count, uint32_t exponent,
+		const signature_t& sign, license_t& license, EMontKernel kernel = mont_batch_kernel());
+
+	// little-endian block (signature, modulus) to limbs
+	void mont_import(mont_limbs_t& r, const uint8_t* data);
+	// limbs to big-endian block (decrypted license), as bi_export does
+	void mont_export(const mont_limbs_t& a, uint8_t* data);
+}
+
+#endif // _IDA_RSA_MONT_HPP_
\ No newline at end of file
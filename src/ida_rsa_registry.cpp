@@ -0,0 +1,163 @@
+/*
+* Known rsa moduli registry file
+*
+* RnD, 2021
+*/
+
+#include <cstring>
+#include <fstream>
+
+#include "ida_rsa_registry.hpp"
+
+namespace ida
+{
+	static_assert(sizeof(registry_header_t) % 8 == 0, "entries must stay 8-byte aligned");
+	static_assert(sizeof(registry_entry_t) % 8 == 0, "entries must stay 8-byte aligned");
+
+	// the file is not trusted, loading checks what is cheap to check,
+	// the montgomery reduction constants are checked by the modulus on first use
+	static bool check_entry(const registry_entry_t& entry)
+	{
+		if (!memchr(entry.name, 0, sizeof(entry.name))) return false;
+		if (entry.flags & ~static_cast<uint32_t>(ERegistryFlag_Mont)) return false;
+
+		// public exponents are odd and above 1
+		if (entry.exponent < 3 || !(entry.exponent & 1)) return false;
+		if (!(entry.flags & ERegistryFlag_Mont)) return true;
+
+		// the montgomery path needs an odd modulus, n is its limbs and n0inv = -n^-1 mod 2^64
+		mont_limbs_t n;
+		mont_import(n, entry.modulus);
+		return (n[0] & 1) && !memcmp(n, entry.mont.n, sizeof(mont_limbs_t)) &&
+			n[0] * entry.mont.n0inv == ~static_cast<uint64_t>(0);
+	}
+
+	// entries of a mapped file, nullptr if it is not a valid registry
+	static const registry_entry_t* map_entries(const uint8_t* data, size_t size, size_t& count)
+	{
+		count = 0;
+		if (!data || size < sizeof(registry_header_t)) return nullptr;
+
+		const registry_header_t* header = reinterpret_cast<const registry_header_t*>(data);
+		if (header->magic != IDA_REGISTRY_MAGIC ||
+			header->version != IDA_REGISTRY_VERSION ||
+			header->entry_size != sizeof(registry_entry_t))
+			return nullptr;
+
+		if (header->count > (size - sizeof(registry_header_t)) / sizeof(registry_entry_t))
+			return nullptr;
+
+		const registry_entry_t* entries =
+			reinterpret_cast<const registry_entry_t*>(data + sizeof(registry_header_t));
+		for (size_t i = 0; i < header->count; ++i)
+			if (!check_entry(entries[i])) return nullptr;
+
+		count = header->count;
+		return entries;
+	}
+
+	bool make_registry_entry(registry_entry_t& entry, const uint8_t* modulus, const string& name,
+		uint32_t exponent)
+	{
+		if (name.size() >= sizeof(entry.name)) return false;
+
+		memset(&entry, 0, sizeof(registry_entry_t));
+		memcpy(entry.name, name.c_str(), name.size());
+		entry.exponent = exponent;
+		memcpy(entry.modulus, modulus, sizeof(signature_t));
+
+		// even moduli stay on the bigint path
+		if (mont_init(entry.mont, modulus))
+			entry.flags |= ERegistryFlag_Mont;
+		else
+			memset(&entry.mont, 0, sizeof(mont_modulus_t));
+		return true;
+	}
+
+	bool make_registry_entry(registry_entry_t& entry, const uint8_t* modulus,
+		const mont_modulus_t& mont, const string& name, uint32_t exponent)
+	{
+		if (name.size() >= sizeof(entry.name)) return false;
+
+		memset(&entry, 0, sizeof(registry_entry_t));
+		memcpy(entry.name, name.c_str(), name.size());
+		entry.exponent = exponent;
+		entry.flags = ERegistryFlag_Mont;
+		memcpy(entry.modulus, modulus, sizeof(signature_t));
+		memcpy(&entry.mont, &mont, sizeof(mont_modulus_t));
+		return true;
+	}
+
+	bool write_registry(const path& filepath, const registry_entry_t* entries, size_t count)
+	{
+		registry_header_t header;
+		header.magic = IDA_REGISTRY_MAGIC;
+		header.version = IDA_REGISTRY_VERSION;
+		header.count = static_cast<uint32_t>(count);
+		header.entry_size = sizeof(registry_entry_t);
+
+		ofstream file(filepath, ios::binary | ios::trunc);
+		if (!file) return false;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(entries), count * sizeof(registry_entry_t));
+		return file.good();
+	}
+
+	bool read_registry(const path& filepath, vector<registry_entry_t>& entries)
+	{
+		mapped_file file;
+		if (!file.open(filepath)) return false;
+
+		size_t count;
+		const registry_entry_t* mapped = map_entries(file.data(), file.size(), count);
+		if (!mapped) return false;
+
+		entries.assign(mapped, mapped + count);
+		return true;
+	}
+
+	bool rsa_registry::load(const path& filepath)
+	{
+		lock_guard<mutex> lock(m_load);
+
+		shared_ptr<registry_view_t> view = make_shared<registry_view_t>();
+		if (!view->file.open(filepath)) return false;
+
+		view->entries = map_entries(view->file.data(), view->file.size(), view->count);
+		if (!view->entries) return false;
+
+		// constants come from the file, checked by map_entries and the modulus
+		shared_ptr<rsa_verifier> verifier = make_shared<rsa_verifier>();
+		for (size_t i = 0; i < view->count; ++i)
+		{
+			const registry_entry_t& entry = view->entries[i];
+			if (entry.flags & ERegistryFlag_Mont)
+				verifier->add(entry.modulus, entry.mont, entry.name, entry.exponent);
+			else
+				verifier->add(entry.modulus, entry.name, entry.exponent);
+		}
+
+		shared_ptr<const registry_view_t> previous = atomic_load(&m_view);
+		if (previous)
+			verifier->copy_stats(*previous->verifier);
+
+		// the previous file stays mapped until its last reader drops it
+		view->filepath = filepath;
+		view->verifier = verifier;
+		atomic_store(&m_view, shared_ptr<const registry_view_t>(view));
+		return true;
+	}
+
+	bool rsa_registry::reload()
+	{
+		shared_ptr<const registry_view_t> view = atomic_load(&m_view);
+		return view && load(view->filepath);
+	}
+
+	shared_ptr<const rsa_verifier> rsa_registry::verifier() const
+	{
+		shared_ptr<const registry_view_t> view = atomic_load(&m_view);
+		return view ? view->verifier : nullptr;
+	}
+}
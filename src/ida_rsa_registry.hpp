@@ -0,0 +1,100 @@
+/*
+* Known rsa moduli registry file header
+*
+* RnD, 2021
+*/
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _IDA_RSA_REGISTRY_HPP_
+#define _IDA_RSA_REGISTRY_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <filesystem>
+
+#include "ida_rsa.hpp"
+#include "ida_mapped_file.hpp"
+
+#define IDA_REGISTRY_MAGIC		0x52534449 // "IDSR"
+#define IDA_REGISTRY_VERSION	1
+#define IDA_REGISTRY_NAME_SIZE	32
+
+namespace ida
+{
+	using namespace std;
+	using namespace filesystem;
+
+	// file layout, little-endian: header, then count entries of entry_size bytes
+	typedef struct registry_header_t
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t count;
+		uint32_t entry_size;
+	} registry_header_t;
+
+	enum ERegistryFlag
+	{
+		ERegistryFlag_Mont = 1 << 0, // mont holds the montgomery constants
+	};
+
+	// one known modulus with everything decryption needs precomputed
+	typedef struct registry_entry_t
+	{
+		char name[IDA_REGISTRY_NAME_SIZE]; // zero terminated
+		uint32_t exponent;
+		uint32_t flags;
+		signature_t modulus;
+		mont_modulus_t mont;
+	} registry_entry_t;
+
+	// fill an entry, computes the montgomery constants
+	bool make_registry_entry(registry_entry_t& entry, const uint8_t* modulus, const string& name,
+		uint32_t exponent = ida_rsa_pub);
+
+	// fill an entry from montgomery constants computed elsewhere
+	bool make_registry_entry(registry_entry_t& entry, const uint8_t* modulus,
+		const mont_modulus_t& mont, const string& name, uint32_t exponent = ida_rsa_pub);
+
+	// write a registry file, replaces an existing one
+	bool write_registry(const path& filepath, const registry_entry_t* entries, size_t count);
+	// copy the entries of a registry file, without mapping it for the verifier
+	bool read_registry(const path& filepath, vector<registry_entry_t>& entries);
+
+	// one loaded registry file, its entries stay mapped while the view is held
+	struct registry_view_t
+	{
+		path filepath;
+		mapped_file file;
+		const registry_entry_t* entries = nullptr;
+		size_t count = 0;
+		shared_ptr<const rsa_verifier> verifier;
+	};
+
+	// mapped registry file and the verifier built from it,
+	// a later load or reload swaps the view, readers holding the previous one keep using it
+	class rsa_registry
+	{
+	public:
+		// false keeps the current view
+		bool load(const path& filepath);
+		// the loaded file again, e.g. once new moduli were written to it
+		bool reload();
+
+		// nullptr until a registry was loaded
+		shared_ptr<const registry_view_t> view() const { return atomic_load(&m_view); }
+		shared_ptr<const rsa_verifier> verifier() const;
+
+	private:
+		mutex m_load; // one load at a time, readers do not wait
+		shared_ptr<const registry_view_t> m_view;
+	};
+}
+
+#endif // _IDA_RSA_REGISTRY_HPP_
@@ -0,0 +1,268 @@
+/*
+* Patched rsa moduli discovery
+*
+* RnD, 2021
+*/
+
+#include <cstring>
+#include <thread>
+#include <algorithm>
+#include <memory>
+
+#include "ida_rsa_scan.hpp"
+#include "ida_rsa.hpp"
+#include "ida_cpu.hpp"
+
+#if defined(IDA_CPU_X86)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace ida
+{
+	// compared bytes at each end of the block before the full check
+	const size_t k_probe = 32;
+
+	typedef struct scan_limits_t
+	{
+		size_t tail; // equal tail bytes below this reject the offset
+		size_t total; // equal head + tail bytes for the distance rule
+		size_t suffix; // equal tail bytes for the suffix rule
+	} scan_limits_t;
+
+	static inline uint32_t bit_count(uint32_t x)
+	{
+#if defined(_MSC_VER) && defined(IDA_CPU_X86)
+		return __popcnt(x);
+#elif defined(__GNUC__) || defined(__clang__)
+		return static_cast<uint32_t>(__builtin_popcount(x));
+#else
+		uint32_t n = 0;
+		for (; x; x &= x - 1) ++n;
+		return n;
+#endif
+	}
+
+	static scan_limits_t get_limits(const scan_options_t& options)
+	{
+		// a block passing either rule can not have fewer equal probe bytes
+		scan_limits_t limits;
+		limits.suffix = min(options.min_suffix, k_probe);
+		limits.total = options.max_distance < 2 * k_probe ? 2 * k_probe - options.max_distance : 0;
+		limits.tail = min(limits.suffix, options.max_distance < k_probe ? k_probe - options.max_distance : 0);
+		return limits;
+	}
+
+	// exact rules on a block that passed the probes
+	static void check_block(const uint8_t* data, size_t offset, const uint8_t* reference,
+		const scan_options_t& options, vector<modulus_candidate_t>& candidates)
+	{
+		const uint8_t* block = data + offset;
+
+		uint32_t distance = 0;
+		for (size_t i = 0; i < IDA_RSA_BLOCK_SIZE; ++i)
+			distance += block[i] != reference[i];
+
+		uint32_t suffix = 0;
+		while (suffix < IDA_RSA_BLOCK_SIZE &&
+			block[IDA_RSA_BLOCK_SIZE - 1 - suffix] == reference[IDA_RSA_BLOCK_SIZE - 1 - suffix])
+			++suffix;
+
+		if (distance > options.max_distance && suffix < options.min_suffix)
+			return;
+
+		modulus_candidate_t candidate;
+		candidate.offset = offset;
+		candidate.distance = distance;
+		candidate.suffix = suffix;
+		candidate.validated = false;
+		memcpy(candidate.modulus, block, sizeof(signature_t));
+		candidates.push_back(candidate);
+	}
+
+	static void scalar_scan(const uint8_t* data, size_t begin, size_t end, const uint8_t* reference,
+		const scan_options_t& options, vector<modulus_candidate_t>& candidates)
+	{
+		const scan_limits_t limits = get_limits(options);
+		const uint8_t* ref_tail = reference + IDA_RSA_BLOCK_SIZE - k_probe;
+
+		for (size_t offset = begin; offset < end; ++offset)
+		{
+			const uint8_t* tail = data + offset + IDA_RSA_BLOCK_SIZE - k_probe;
+			size_t eq_tail = 0;
+			for (size_t i = 0; i < k_probe; ++i)
+				eq_tail += tail[i] == ref_tail[i];
+			if (eq_tail < limits.tail) continue;
+
+			if (eq_tail < limits.suffix)
+			{
+				size_t eq_head = 0;
+				for (size_t i = 0; i < k_probe; ++i)
+					eq_head += data[offset + i] == reference[i];
+				if (eq_head + eq_tail < limits.total) continue;
+			}
+			check_block(data, offset, reference, options, candidates);
+		}
+	}
+
+#if defined(IDA_CPU_X86)
+	static void sse2_scan(const uint8_t* data, size_t begin, size_t end, const uint8_t* reference,
+		const scan_options_t& options, vector<modulus_candidate_t>& candidates)
+	{
+		const scan_limits_t limits = get_limits(options);
+		const uint8_t* ref_tail = reference + IDA_RSA_BLOCK_SIZE - k_probe;
+		const __m128i rh0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(reference));
+		const __m128i rh1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(reference + 16));
+		const __m128i rt0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ref_tail));
+		const __m128i rt1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ref_tail + 16));
+
+		for (size_t offset = begin; offset < end; ++offset)
+		{
+			const uint8_t* head = data + offset;
+			const uint8_t* tail = head + IDA_RSA_BLOCK_SIZE - k_probe;
+
+			uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(tail)), rt0)));
+			mask |= static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(tail + 16)), rt1))) << 16;
+			size_t eq_tail = bit_count(mask);
+			if (eq_tail < limits.tail) continue;
+
+			if (eq_tail < limits.suffix)
+			{
+				mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+					_mm_loadu_si128(reinterpret_cast<const __m128i*>(head)), rh0)));
+				mask |= static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+					_mm_loadu_si128(reinterpret_cast<const __m128i*>(head + 16)), rh1))) << 16;
+				if (bit_count(mask) + eq_tail < limits.total) continue;
+			}
+			check_block(data, offset, reference, options, candidates);
+		}
+	}
+
+	IDA_TARGET("avx2,popcnt")
+	static void avx2_scan(const uint8_t* data, size_t begin, size_t end, const uint8_t* reference,
+		const scan_options_t& options, vector<modulus_candidate_t>& candidates)
+	{
+		const scan_limits_t limits = get_limits(options);
+		const __m256i rh = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(reference));
+		const __m256i rt = _mm256_loadu_si256(
+			reinterpret_cast<const __m256i*>(reference + IDA_RSA_BLOCK_SIZE - k_probe));
+
+		for (size_t offset = begin; offset < end; ++offset)
+		{
+			const uint8_t* head = data + offset;
+			const uint8_t* tail = head + IDA_RSA_BLOCK_SIZE - k_probe;
+
+			uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(tail)), rt)));
+			size_t eq_tail = _mm_popcnt_u32(mask);
+			if (eq_tail < limits.tail) continue;
+
+			if (eq_tail < limits.suffix)
+			{
+				mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+					_mm256_loadu_si256(reinterpret_cast<const __m256i*>(head)), rh)));
+				if (_mm_popcnt_u32(mask) + eq_tail < limits.total) continue;
+			}
+			check_block(data, offset, reference, options, candidates);
+		}
+	}
+#endif
+
+	static void scan_range(const uint8_t* data, size_t begin, size_t end, const uint8_t* reference,
+		const scan_options_t& options, vector<modulus_candidate_t>& candidates)
+	{
+#if defined(IDA_CPU_X86)
+		if (has_cpu_feature(ECpuFeature_AVX2))
+			return avx2_scan(data, begin, end, reference, options, candidates);
+		if (has_cpu_feature(ECpuFeature_SSE2))
+			return sse2_scan(data, begin, end, reference, options, candidates);
+#endif
+		scalar_scan(data, begin, end, reference, options, candidates);
+	}
+
+	size_t scan_moduli(const uint8_t* data, size_t size, const uint8_t* reference,
+		vector<modulus_candidate_t>& candidates, const scan_options_t& options)
+	{
+		candidates.clear();
+		if (!data || size < IDA_RSA_BLOCK_SIZE) return 0;
+
+		// block start offsets, a worker reads up to a block past its last one
+		size_t offsets = size - IDA_RSA_BLOCK_SIZE + 1;
+
+		unsigned threads = options.threads;
+		if (!threads)
+			threads = max(thread::hardware_concurrency(), 1u);
+
+		// small images are not worth a thread
+		const size_t min_chunk = 1 << 20;
+		size_t workers = min(static_cast<size_t>(threads), (offsets + min_chunk - 1) / min_chunk);
+		if (workers <= 1)
+		{
+			scan_range(data, 0, offsets, reference, options, candidates);
+			return candidates.size();
+		}
+
+		vector<vector<modulus_candidate_t>> found(workers);
+		vector<thread> pool;
+		pool.reserve(workers - 1);
+
+		size_t chunk = offsets / workers, rest = offsets % workers, begin = 0;
+		for (size_t w = 0; w < workers; ++w)
+		{
+			size_t end = begin + chunk + (w < rest ? 1 : 0);
+			auto job = [=, &found]()
+			{
+				scan_range(data, begin, end, reference, options, found[w]);
+			};
+
+			// the calling thread takes the last slice
+			if (w + 1 == workers)
+				job();
+			else
+				pool.emplace_back(job);
+			begin = end;
+		}
+		for (auto& t : pool)
+			t.join();
+
+		// slices are in order, so are their candidates
+		for (auto& part : found)
+			candidates.insert(candidates.end(), part.begin(), part.end());
+		return candidates.size();
+	}
+
+	// a wrong modulus gives random bytes, these fields are fixed in every known license
+	static bool is_license_plausible(const license_t& license)
+	{
+		return license.zero == 0 && license.reserved0 == -1 && license.reserved1 == -1;
+	}
+
+	size_t validate_candidates(vector<modulus_candidate_t>& candidates,
+		const signature_t* samples, size_t count, uint32_t exponent)
+	{
+		size_t validated = 0;
+		vector<license_t> licenses(count);
+		unique_ptr<bool[]> results(new bool[count]);
+
+		for (auto& candidate : candidates)
+		{
+			candidate.validated = false;
+
+			rsa_modulus mod(candidate.modulus, "", exponent);
+			mod.decrypt(samples, licenses.data(), results.get(), count);
+
+			for (size_t i = 0; i < count; ++i)
+				if (results[i] && is_license_plausible(licenses[i]))
+				{
+					candidate.validated = true;
+					++validated;
+					break;
+				}
+		}
+		return validated;
+	}
+}
@@ -0,0 +1,55 @@
+/*
+* Patched rsa moduli discovery header
+*
+* RnD, 2021
+*/
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _IDA_RSA_SCAN_HPP_
+#define _IDA_RSA_SCAN_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include "ida_license.hpp"
+
+// known patches differ in a few bytes, or rewrite the head and keep the tail
+#define IDA_SCAN_MAX_DISTANCE	16
+#define IDA_SCAN_MIN_SUFFIX		16
+
+namespace ida
+{
+	using namespace std;
+
+	typedef struct scan_options_t
+	{
+		size_t max_distance = IDA_SCAN_MAX_DISTANCE; // differing bytes
+		size_t min_suffix = IDA_SCAN_MIN_SUFFIX; // shared trailing bytes
+		unsigned threads = 0; // 0 = one per core
+	} scan_options_t;
+
+	// block of an image close to the reference modulus
+	typedef struct modulus_candidate_t
+	{
+		size_t offset;
+		uint32_t distance; // differing bytes, 0 is the reference itself
+		uint32_t suffix; // shared trailing bytes
+		bool validated; // decrypted a sample signature
+		signature_t modulus;
+	} modulus_candidate_t;
+
+	// every block within max_distance of the reference or sharing min_suffix
+	// trailing bytes with it, by offset, the image is split over worker threads
+	size_t scan_moduli(const uint8_t* data, size_t size, const uint8_t* reference,
+		vector<modulus_candidate_t>& candidates, const scan_options_t& options = scan_options_t());
+
+	// trial decryption of the samples, a candidate is validated by the first
+	// sample that gives a well-formed license, returns the number of validated ones
+	size_t validate_candidates(vector<modulus_candidate_t>& candidates,
+		const signature_t* samples, size_t count, uint32_t exponent = ida_rsa_pub);
+}
+
+#endif // _IDA_RSA_SCAN_HPP_
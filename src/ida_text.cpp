@@ -0,0 +1,234 @@
+/*
+* Vectorized text scanning
+*
+* RnD, 2021
+*/
+
+#include <cstring>
+
+#include "ida_text.hpp"
+#include "ida_cpu.hpp"
+
+#if defined(IDA_CPU_X86)
+#include <immintrin.h>
+#endif
+
+namespace ida
+{
+	static inline unsigned lowest_bit(uint64_t mask)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward64(&index, mask);
+		return static_cast<unsigned>(index);
+#else
+		return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+	}
+
+	// bits of a 64-byte block to offsets, false once ends is full,
+	// done is set past the last reported newline then
+	static inline bool push_mask(uint64_t mask, size_t base, size_t* ends, size_t capacity,
+		size_t& count, size_t& done)
+	{
+		while (mask)
+		{
+			if (count == capacity)
+			{
+				done = ends[count - 1] + 1;
+				return false;
+			}
+			ends[count++] = base + lowest_bit(mask);
+			mask &= mask - 1;
+		}
+		return true;
+	}
+
+	static size_t scalar_newlines(const char* text, size_t size, size_t begin, size_t* ends,
+		size_t capacity, size_t& count, size_t& scanned)
+	{
+		for (size_t i = begin; i < size; ++i)
+		{
+			if (text[i] != '\n') continue;
+			if (count == capacity)
+			{
+				scanned = ends[count - 1] + 1;
+				return count;
+			}
+			ends[count++] = i;
+		}
+		scanned = size;
+		return count;
+	}
+
+#if defined(IDA_CPU_X86)
+	static size_t sse2_newlines(const char* text, size_t size, size_t* ends, size_t capacity,
+		size_t& scanned)
+	{
+		const __m128i nl = _mm_set1_epi8('\n');
+		size_t count = 0, i = 0;
+
+		for (; i + 64 <= size; i += 64)
+		{
+			uint64_t mask = 0;
+			for (size_t j = 0; j < 4; ++j)
+			{
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + j * 16));
+				mask |= static_cast<uint64_t>(static_cast<uint32_t>(
+					_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)))) << (j * 16);
+			}
+			if (!push_mask(mask, i, ends, capacity, count, scanned))
+				return count;
+		}
+		return scalar_newlines(text, size, i, ends, capacity, count, scanned);
+	}
+
+	IDA_TARGET("avx2")
+	static size_t avx2_newlines(const char* text, size_t size, size_t* ends, size_t capacity,
+		size_t& scanned)
+	{
+		const __m256i nl = _mm256_set1_epi8('\n');
+		size_t count = 0, i = 0;
+
+		for (; i + 64 <= size; i += 64)
+		{
+			__m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+			__m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + 32));
+			uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, nl))) |
+				(static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, nl)))) << 32);
+			if (!push_mask(mask, i, ends, capacity, count, scanned))
+				return count;
+		}
+		return scalar_newlines(text, size, i, ends, capacity, count, scanned);
+	}
+#endif
+
+	// two pattern bytes every candidate must match before the full compare,
+	// zero and 0xff fill most binaries and make a poor filter
+	typedef struct anchors_t
+	{
+		size_t first;
+		size_t last;
+	} anchors_t;
+
+	static anchors_t get_anchors(const uint8_t* pattern, size_t length)
+	{
+		anchors_t anchors = { 0, length - 1 };
+		auto rare = [&](size_t i) { return pattern[i] != 0x00 && pattern[i] != 0xff; };
+
+		size_t first = 0, last = length - 1;
+		while (first < length && !rare(first)) ++first;
+		while (last > first && !rare(last)) --last;
+		if (first < length)
+		{
+			anchors.first = first;
+			anchors.last = last;
+		}
+		return anchors;
+	}
+
+	static size_t scalar_bytes(const uint8_t* data, size_t size, size_t begin, const uint8_t* pattern,
+		size_t length, const anchors_t& anchors)
+	{
+		const uint8_t a = pattern[anchors.first];
+		for (size_t i = begin; i + length <= size; ++i)
+		{
+			const void* next = memchr(data + i + anchors.first, a, size - length + 1 - i);
+			if (!next) break;
+
+			i = static_cast<const uint8_t*>(next) - data - anchors.first;
+			if (data[i + anchors.last] == pattern[anchors.last] && !memcmp(data + i, pattern, length))
+				return i;
+		}
+		return size;
+	}
+
+	// candidate bits to the first full match, the filter bytes are already equal
+	static inline bool check_mask(uint64_t mask, const uint8_t* data, size_t base, const uint8_t* pattern,
+		size_t length, size_t& found)
+	{
+		while (mask)
+		{
+			size_t i = base + lowest_bit(mask);
+			if (!memcmp(data + i, pattern, length))
+			{
+				found = i;
+				return true;
+			}
+			mask &= mask - 1;
+		}
+		return false;
+	}
+
+#if defined(IDA_CPU_X86)
+	static size_t sse2_bytes(const uint8_t* data, size_t size, const uint8_t* pattern, size_t length,
+		const anchors_t& anchors)
+	{
+		const __m128i a = _mm_set1_epi8(static_cast<char>(pattern[anchors.first]));
+		const __m128i b = _mm_set1_epi8(static_cast<char>(pattern[anchors.last]));
+		size_t i = 0, found;
+
+		// every candidate of a block has the whole pattern in data
+		for (; i + 16 + length - 1 <= size; i += 16)
+		{
+			__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + anchors.first));
+			__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + anchors.last));
+			uint64_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+				_mm_and_si128(_mm_cmpeq_epi8(x, a), _mm_cmpeq_epi8(y, b))));
+			if (mask && check_mask(mask, data, i, pattern, length, found))
+				return found;
+		}
+		return scalar_bytes(data, size, i, pattern, length, anchors);
+	}
+
+	IDA_TARGET("avx2")
+	static size_t avx2_bytes(const uint8_t* data, size_t size, const uint8_t* pattern, size_t length,
+		const anchors_t& anchors)
+	{
+		const __m256i a = _mm256_set1_epi8(static_cast<char>(pattern[anchors.first]));
+		const __m256i b = _mm256_set1_epi8(static_cast<char>(pattern[anchors.last]));
+		size_t i = 0, found;
+
+		for (; i + 32 + length - 1 <= size; i += 32)
+		{
+			__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + anchors.first));
+			__m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + anchors.last));
+			uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+				_mm256_and_si256(_mm256_cmpeq_epi8(x, a), _mm256_cmpeq_epi8(y, b))));
+			if (mask && check_mask(mask, data, i, pattern, length, found))
+				return found;
+		}
+		return scalar_bytes(data, size, i, pattern, length, anchors);
+	}
+#endif
+
+	size_t find_bytes(const uint8_t* data, size_t size, const uint8_t* pattern, size_t length)
+	{
+		if (!length) return 0;
+		if (length > size) return size;
+
+		const anchors_t anchors = get_anchors(pattern, length);
+#if defined(IDA_CPU_X86)
+		if (has_cpu_feature(ECpuFeature_AVX2))
+			return avx2_bytes(data, size, pattern, length, anchors);
+		if (has_cpu_feature(ECpuFeature_SSE2))
+			return sse2_bytes(data, size, pattern, length, anchors);
+#endif
+		return scalar_bytes(data, size, 0, pattern, length, anchors);
+	}
+
+	size_t find_newlines(const char* text, size_t size, size_t* ends, size_t capacity, size_t& scanned)
+	{
+		scanned = 0;
+		if (!capacity) return 0;
+
+#if defined(IDA_CPU_X86)
+		if (has_cpu_feature(ECpuFeature_AVX2))
+			return avx2_newlines(text, size, ends, capacity, scanned);
+		if (has_cpu_feature(ECpuFeature_SSE2))
+			return sse2_newlines(text, size, ends, capacity, scanned);
+#endif
+		size_t count = 0;
+		return scalar_newlines(text, size, 0, ends, capacity, count, scanned);
+	}
+}
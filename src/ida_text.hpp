@@ -0,0 +1,29 @@
+/*
+* Vectorized text scanning header
+*
+* RnD, 2021
+*/
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#ifndef _IDA_TEXT_HPP_
+#define _IDA_TEXT_HPP_
+
+#include <cstdint>
+#include <cstddef>
+
+namespace ida
+{
+	using namespace std;
+
+	// offsets of the '\n' bytes in text, at most capacity of them,
+	// scanned is set to the bytes examined, all of size unless ends filled up
+	size_t find_newlines(const char* text, size_t size, size_t* ends, size_t capacity, size_t& scanned);
+
+	// offset of the first pattern in data, size if there is none
+	size_t find_bytes(const uint8_t* data, size_t size, const uint8_t* pattern, size_t length);
+}
+
+#endif // _IDA_TEXT_HPP_